@@ -0,0 +1,1378 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+// Stand-in for MPD serving a synthetic database. It speaks enough of the
+// protocol for ncmpcpp to work against it, so that heavy paths (loading
+// the library, playlist synchronisation, searching) can be measured in
+// a reproducible way without real music collection and real server.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+enum Event
+{
+	evDatabase = 1 << 0,
+	evUpdate = 1 << 1,
+	evStoredPlaylist = 1 << 2,
+	evPlaylist = 1 << 3,
+	evPlayer = 1 << 4,
+	evMixer = 1 << 5,
+	evOutput = 1 << 6,
+	evOptions = 1 << 7,
+	evAll = (1 << 8) - 1
+};
+
+const char *event_names[] = {
+	"database", "update", "stored_playlist", "playlist",
+	"player", "mixer", "output", "options"
+};
+
+enum AckError
+{
+	ackNotList = 1,
+	ackArg = 2,
+	ackPassword = 3,
+	ackPermission = 4,
+	ackUnknown = 5,
+	ackNoExist = 50
+};
+
+struct Error
+{
+	Error(AckError code_, std::string msg_)
+	: code(code_), msg(std::move(msg_)) { }
+
+	AckError code;
+	std::string msg;
+};
+
+struct Song
+{
+	std::string uri;
+	std::string artist;
+	std::string album_artist;
+	std::string album;
+	std::string title;
+	std::string track;
+	std::string date;
+	std::string genre;
+	unsigned duration;
+	time_t mtime;
+};
+
+struct QueueEntry
+{
+	size_t song;
+	unsigned id;
+	unsigned version;
+	unsigned prio;
+};
+
+struct Output
+{
+	Clock::time_point ready;
+	std::string data;
+};
+
+struct Client
+{
+	Client(int fd_)
+	: fd(fd_), idle(false), idle_mask(0), pending(0)
+	, in_list(false), list_ok(false), closing(false), written(0)
+	{ }
+
+	int fd;
+	std::string input;
+
+	bool idle;
+	unsigned idle_mask;
+	unsigned pending;
+
+	bool in_list;
+	bool list_ok;
+	std::vector<std::string> list;
+
+	bool closing;
+	std::deque<Output> output;
+	size_t written;
+};
+
+typedef std::vector<std::string> Args;
+
+/**********************************************************************/
+
+// settings
+unsigned port = 6600;
+std::string bind_address = "127.0.0.1";
+size_t songs_count = 10000;
+size_t queue_count = 0;
+unsigned latency = 0;
+unsigned seed = 1;
+std::string scenario;
+unsigned scenario_interval = 1000;
+
+// database
+std::vector<Song> db;
+time_t db_update;
+
+// queue and player
+std::vector<QueueEntry> queue;
+unsigned queue_version = 1;
+unsigned next_id = 1;
+enum class State { Stop, Play, Pause } state = State::Stop;
+int current = -1;
+Clock::time_point play_start;
+unsigned elapsed_before_start = 0;
+int volume = 100;
+bool repeat = false, random_mode = false, single = false, consume = false;
+unsigned crossfade = 0;
+
+std::vector<Client> clients;
+Clock::time_point next_scenario_step;
+
+/**********************************************************************/
+
+std::string format_time(time_t t)
+{
+	char buf[32];
+	tm info;
+	gmtime_r(&t, &info);
+	strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &info);
+	return buf;
+}
+
+std::string lowercase(std::string s)
+{
+	std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+	return s;
+}
+
+unsigned to_unsigned(const std::string &s)
+{
+	char *end;
+	errno = 0;
+	unsigned long result = strtoul(s.c_str(), &end, 10);
+	if (s.empty() || *end != 0 || errno != 0)
+		throw Error(ackArg, "Integer expected: " + s);
+	return result;
+}
+
+int to_int(const std::string &s)
+{
+	char *end;
+	errno = 0;
+	long result = strtol(s.c_str(), &end, 10);
+	if (s.empty() || *end != 0 || errno != 0)
+		throw Error(ackArg, "Integer expected: " + s);
+	return result;
+}
+
+bool to_bool(const std::string &s)
+{
+	if (s == "0")
+		return false;
+	else if (s == "1")
+		return true;
+	else
+		throw Error(ackArg, "Boolean (0/1) expected: " + s);
+}
+
+// parses either single position or range START:END
+std::pair<unsigned, unsigned> to_range(const std::string &s)
+{
+	size_t colon = s.find(':');
+	if (colon == std::string::npos)
+	{
+		unsigned pos = to_unsigned(s);
+		return std::make_pair(pos, pos+1);
+	}
+	unsigned start = to_unsigned(s.substr(0, colon));
+	std::string end = s.substr(colon+1);
+	return std::make_pair(start, end.empty() ? queue.size() : to_unsigned(end));
+}
+
+/**********************************************************************/
+
+void generate_database()
+{
+	const char *genres[] = {
+		"Rock", "Jazz", "Classical", "Electronic", "Metal", "Pop",
+		"Folk", "Blues", "Ambient", "Hip-Hop", "Soundtrack", "Reggae"
+	};
+	const char *words[] = {
+		"Night", "Blue", "River", "Fire", "Dream", "Stone", "Light", "Rain",
+		"Ghost", "Heart", "Silver", "Road", "Storm", "Echo", "Garden", "Winter"
+	};
+	const size_t albums_per_artist = 10;
+	const size_t tracks_per_album = 10;
+
+	// names of artists and albums have to be the same for all their songs,
+	// so they're generated from separate generators seeded with their index
+	std::mt19937 rng(seed);
+	auto word = [&words](std::mt19937 &g) -> std::string {
+		return words[g() % (sizeof(words)/sizeof(*words))];
+	};
+
+	db_update = 1388534400; // 2014-01-01
+	db.reserve(songs_count);
+	for (size_t i = 0; i < songs_count; ++i)
+	{
+		size_t artist_idx = i / (albums_per_artist*tracks_per_album);
+		size_t album_idx = i / tracks_per_album % albums_per_artist;
+		size_t track_idx = i % tracks_per_album;
+
+		char buf[64];
+		Song s;
+		std::mt19937 artist_rng(seed + artist_idx);
+		std::string w1 = word(artist_rng), w2 = word(artist_rng);
+		snprintf(buf, sizeof(buf), "%s %s %zu", w1.c_str(), w2.c_str(), artist_idx);
+		// some artists start with "the", so that ignore_leading_the matters
+		s.artist = artist_idx % 7 == 0 ? std::string("The ") + buf : buf;
+		s.album_artist = s.artist;
+		std::mt19937 album_rng(seed + artist_idx*albums_per_artist + album_idx);
+		w1 = word(album_rng), w2 = word(album_rng);
+		snprintf(buf, sizeof(buf), "%s of %s %zu", w1.c_str(), w2.c_str(), album_idx);
+		s.album = buf;
+		w1 = word(rng), w2 = word(rng);
+		snprintf(buf, sizeof(buf), "%s %s", w1.c_str(), w2.c_str());
+		s.title = buf;
+		snprintf(buf, sizeof(buf), "%02zu/%02zu", track_idx+1, tracks_per_album);
+		s.track = buf;
+		snprintf(buf, sizeof(buf), "%zu", 1960 + (artist_idx*7 + album_idx) % 55);
+		s.date = buf;
+		s.genre = genres[artist_idx % (sizeof(genres)/sizeof(*genres))];
+		s.duration = 120 + rng() % 360;
+		s.mtime = db_update - rng() % (3*365*24*3600);
+
+		snprintf(buf, sizeof(buf), "artist%06zu/album%02zu/%02zu.flac", artist_idx, album_idx, track_idx+1);
+		s.uri = buf;
+		db.push_back(std::move(s));
+	}
+	std::sort(db.begin(), db.end(), [](const Song &a, const Song &b) {
+		return a.uri < b.uri;
+	});
+}
+
+// returns range of songs within given directory
+std::pair<size_t, size_t> directory_range(const std::string &path)
+{
+	if (path.empty() || path == "/")
+		return std::make_pair(size_t(0), db.size());
+	std::string prefix = path + "/";
+	auto first = std::lower_bound(db.begin(), db.end(), prefix, [](const Song &s, const std::string &p) {
+		return s.uri < p;
+	});
+	auto last = first;
+	while (last != db.end() && last->uri.compare(0, prefix.length(), prefix) == 0)
+		++last;
+	return std::make_pair(first - db.begin(), last - db.begin());
+}
+
+const Song *find_song(const std::string &uri)
+{
+	auto it = std::lower_bound(db.begin(), db.end(), uri, [](const Song &s, const std::string &u) {
+		return s.uri < u;
+	});
+	if (it != db.end() && it->uri == uri)
+		return &*it;
+	return nullptr;
+}
+
+// returns pointer to given tag of the song or nullptr if it's unsupported
+const std::string *get_tag(const Song &s, const std::string &tag)
+{
+	std::string t = lowercase(tag);
+	if (t == "artist")
+		return &s.artist;
+	else if (t == "albumartist")
+		return &s.album_artist;
+	else if (t == "album")
+		return &s.album;
+	else if (t == "title")
+		return &s.title;
+	else if (t == "track")
+		return &s.track;
+	else if (t == "date")
+		return &s.date;
+	else if (t == "genre")
+		return &s.genre;
+	else if (t == "file" || t == "filename")
+		return &s.uri;
+	return nullptr;
+}
+
+const char *tag_name(const std::string &tag)
+{
+	std::string t = lowercase(tag);
+	if (t == "artist")
+		return "Artist";
+	else if (t == "albumartist")
+		return "AlbumArtist";
+	else if (t == "album")
+		return "Album";
+	else if (t == "title")
+		return "Title";
+	else if (t == "track")
+		return "Track";
+	else if (t == "date")
+		return "Date";
+	else if (t == "genre")
+		return "Genre";
+	else if (t == "file")
+		return "file";
+	throw Error(ackArg, "Unknown tag type: " + tag);
+}
+
+void print_song(std::string &out, const Song &s)
+{
+	out += "file: " + s.uri + "\n";
+	out += "Last-Modified: " + format_time(s.mtime) + "\n";
+	out += "Time: " + std::to_string(s.duration) + "\n";
+	out += "Artist: " + s.artist + "\n";
+	out += "AlbumArtist: " + s.album_artist + "\n";
+	out += "Album: " + s.album + "\n";
+	out += "Title: " + s.title + "\n";
+	out += "Track: " + s.track + "\n";
+	out += "Date: " + s.date + "\n";
+	out += "Genre: " + s.genre + "\n";
+}
+
+void print_queue_entry(std::string &out, size_t pos)
+{
+	const QueueEntry &e = queue[pos];
+	print_song(out, db[e.song]);
+	out += "Pos: " + std::to_string(pos) + "\n";
+	out += "Id: " + std::to_string(e.id) + "\n";
+	if (e.prio > 0)
+		out += "Prio: " + std::to_string(e.prio) + "\n";
+}
+
+void print_directory(std::string &out, const std::string &path)
+{
+	out += "directory: " + path + "\n";
+	out += "Last-Modified: " + format_time(db_update) + "\n";
+}
+
+/**********************************************************************/
+
+void emit(unsigned events);
+
+unsigned elapsed()
+{
+	switch (state)
+	{
+		case State::Play:
+			return elapsed_before_start + std::chrono::duration_cast<std::chrono::seconds>(
+				Clock::now() - play_start
+			).count();
+		case State::Pause:
+			return elapsed_before_start;
+		default:
+			return 0;
+	}
+}
+
+void play(int pos)
+{
+	if (pos < 0 || size_t(pos) >= queue.size())
+	{
+		state = State::Stop;
+		current = -1;
+	}
+	else
+	{
+		state = State::Play;
+		current = pos;
+		play_start = Clock::now();
+		elapsed_before_start = 0;
+	}
+	emit(evPlayer);
+}
+
+// marks positions [first, last) as changed in the new queue version
+void queue_changed(size_t first, size_t last)
+{
+	++queue_version;
+	last = std::min(last, queue.size());
+	for (size_t i = first; i < last; ++i)
+		queue[i].version = queue_version;
+	emit(evPlaylist);
+}
+
+unsigned add_to_queue(size_t song, int pos)
+{
+	QueueEntry e;
+	e.song = song;
+	e.id = next_id++;
+	e.version = 0;
+	e.prio = 0;
+	if (pos < 0 || size_t(pos) >= queue.size())
+		pos = queue.size();
+	queue.insert(queue.begin()+pos, e);
+	if (current >= pos)
+		++current;
+	queue_changed(pos, queue.size());
+	return e.id;
+}
+
+int find_id(unsigned id)
+{
+	for (size_t i = 0; i < queue.size(); ++i)
+		if (queue[i].id == id)
+			return i;
+	throw Error(ackNoExist, "No such song");
+}
+
+void delete_range(unsigned first, unsigned last)
+{
+	if (first >= last || last > queue.size())
+		throw Error(ackArg, "Bad song index");
+	queue.erase(queue.begin()+first, queue.begin()+last);
+	if (current >= int(first))
+	{
+		if (current < int(last))
+		{
+			current = -1;
+			state = State::Stop;
+			emit(evPlayer);
+		}
+		else
+			current -= last-first;
+	}
+	queue_changed(first, queue.size());
+}
+
+void move_range(unsigned first, unsigned last, unsigned to)
+{
+	if (first >= last || last > queue.size() || to + (last-first) > queue.size())
+		throw Error(ackArg, "Bad song index");
+	std::vector<QueueEntry> moved(queue.begin()+first, queue.begin()+last);
+	int current_id = current >= 0 ? queue[current].id : -1;
+	queue.erase(queue.begin()+first, queue.begin()+last);
+	queue.insert(queue.begin()+to, moved.begin(), moved.end());
+	if (current_id >= 0)
+		current = find_id(current_id);
+	queue_changed(std::min(first, to), std::max(last, to + (last-first)));
+}
+
+/**********************************************************************/
+
+// matches songs against list of TAG VALUE pairs
+std::vector<size_t> match(const Args &args, size_t begin, bool exact)
+{
+	if ((args.size() - begin) % 2 != 0)
+		throw Error(ackArg, "Incorrect arguments");
+	struct Constraint { std::string tag; std::string value; };
+	std::vector<Constraint> constraints;
+	for (size_t i = begin; i < args.size(); i += 2)
+	{
+		Constraint c;
+		c.tag = lowercase(args[i]);
+		c.value = exact ? args[i+1] : lowercase(args[i+1]);
+		if (c.tag != "any" && c.tag != "base")
+			tag_name(c.tag); // validate
+		constraints.push_back(std::move(c));
+	}
+	auto matches = [exact](const std::string &value, const std::string &pattern) {
+		if (exact)
+			return value == pattern;
+		else
+			return lowercase(value).find(pattern) != std::string::npos;
+	};
+	std::vector<size_t> result;
+	for (size_t i = 0; i < db.size(); ++i)
+	{
+		const Song &s = db[i];
+		bool ok = true;
+		for (auto c = constraints.begin(); ok && c != constraints.end(); ++c)
+		{
+			if (c->tag == "base")
+				ok = s.uri.compare(0, c->value.length(), c->value) == 0;
+			else if (c->tag == "any")
+			{
+				ok = matches(s.uri, c->value)
+				  || matches(s.artist, c->value)
+				  || matches(s.album_artist, c->value)
+				  || matches(s.album, c->value)
+				  || matches(s.title, c->value)
+				  || matches(s.track, c->value)
+				  || matches(s.date, c->value)
+				  || matches(s.genre, c->value);
+			}
+			else
+				ok = matches(*get_tag(s, c->tag), c->value);
+		}
+		if (ok)
+			result.push_back(i);
+	}
+	return result;
+}
+
+void list_directory(std::string &out, const std::string &path, bool recursive, bool meta)
+{
+	auto range = directory_range(path);
+	if (range.first == range.second && !path.empty() && path != "/")
+	{
+		if (const Song *s = find_song(path))
+		{
+			if (meta)
+				print_song(out, *s);
+			else
+				out += "file: " + s->uri + "\n";
+			return;
+		}
+		throw Error(ackNoExist, "No such directory");
+	}
+	std::string prefix = path.empty() || path == "/" ? "" : path + "/";
+	std::string last_dir = prefix;
+	for (size_t i = range.first; i < range.second; ++i)
+	{
+		const Song &s = db[i];
+		size_t slash = s.uri.rfind('/');
+		std::string dir = slash == std::string::npos ? "" : s.uri.substr(0, slash+1);
+		if (!recursive)
+		{
+			if (dir == prefix)
+				print_song(out, s);
+			else
+			{
+				// first level subdirectory
+				size_t end = s.uri.find('/', prefix.length());
+				std::string subdir = s.uri.substr(0, end);
+				if (last_dir != subdir)
+				{
+					print_directory(out, subdir);
+					last_dir = subdir;
+				}
+			}
+			continue;
+		}
+		if (dir != last_dir)
+		{
+			// print all directories between common part and the new one
+			size_t common = 0;
+			while (common < dir.length() && common < last_dir.length() && dir[common] == last_dir[common])
+				++common;
+			common = dir.rfind('/', common ? common-1 : 0);
+			common = common == std::string::npos ? 0 : common+1;
+			if (common < prefix.length())
+				common = prefix.length();
+			for (size_t p = dir.find('/', common); p != std::string::npos; p = dir.find('/', p+1))
+				print_directory(out, dir.substr(0, p));
+			last_dir = dir;
+		}
+		if (meta)
+			print_song(out, s);
+		else
+			out += "file: " + s.uri + "\n";
+	}
+}
+
+/**********************************************************************/
+
+typedef std::function<void(Client &, const Args &, std::string &)> Handler;
+std::map<std::string, Handler> handlers;
+
+void check_args(const Args &args, size_t min, size_t max)
+{
+	if (args.size()-1 < min || args.size()-1 > max)
+		throw Error(ackArg, "wrong number of arguments for \"" + args[0] + "\"");
+}
+
+void register_handlers()
+{
+	auto nothing = [](Client &, const Args &, std::string &) { };
+	handlers["ping"] = nothing;
+	handlers["password"] = nothing;
+	handlers["clearerror"] = nothing;
+
+	handlers["status"] = [](Client &, const Args &, std::string &out) {
+		out += "volume: " + std::to_string(volume) + "\n";
+		out += "repeat: " + std::to_string(repeat) + "\n";
+		out += "random: " + std::to_string(random_mode) + "\n";
+		out += "single: " + std::to_string(single) + "\n";
+		out += "consume: " + std::to_string(consume) + "\n";
+		out += "playlist: " + std::to_string(queue_version) + "\n";
+		out += "playlistlength: " + std::to_string(queue.size()) + "\n";
+		out += "xfade: " + std::to_string(crossfade) + "\n";
+		const char *state_name[] = { "stop", "play", "pause" };
+		out += std::string("state: ") + state_name[int(state)] + "\n";
+		if (current >= 0)
+		{
+			out += "song: " + std::to_string(current) + "\n";
+			out += "songid: " + std::to_string(queue[current].id) + "\n";
+			if (size_t(current+1) < queue.size())
+			{
+				out += "nextsong: " + std::to_string(current+1) + "\n";
+				out += "nextsongid: " + std::to_string(queue[current+1].id) + "\n";
+			}
+			if (state != State::Stop)
+			{
+				unsigned total = db[queue[current].song].duration;
+				out += "time: " + std::to_string(elapsed()) + ":" + std::to_string(total) + "\n";
+				out += "elapsed: " + std::to_string(elapsed()) + ".000\n";
+				out += "bitrate: 1411\n";
+				out += "audio: 44100:16:2\n";
+			}
+		}
+	};
+	handlers["stats"] = [](Client &, const Args &, std::string &out) {
+		std::set<std::string> artists, albums;
+		unsigned long db_playtime = 0;
+		for (auto it = db.begin(); it != db.end(); ++it)
+		{
+			artists.insert(it->artist);
+			albums.insert(it->album);
+			db_playtime += it->duration;
+		}
+		out += "artists: " + std::to_string(artists.size()) + "\n";
+		out += "albums: " + std::to_string(albums.size()) + "\n";
+		out += "songs: " + std::to_string(db.size()) + "\n";
+		out += "uptime: 0\n";
+		out += "playtime: 0\n";
+		out += "db_playtime: " + std::to_string(db_playtime) + "\n";
+		out += "db_update: " + std::to_string(db_update) + "\n";
+	};
+	handlers["currentsong"] = [](Client &, const Args &, std::string &out) {
+		if (current >= 0)
+			print_queue_entry(out, current);
+	};
+	handlers["decoders"] = [](Client &, const Args &, std::string &out) {
+		out += "plugin: flac\nsuffix: flac\nmime_type: audio/flac\n";
+		out += "plugin: mad\nsuffix: mp3\nmime_type: audio/mpeg\n";
+		out += "plugin: vorbis\nsuffix: ogg\nmime_type: audio/ogg\n";
+	};
+	handlers["tagtypes"] = [](Client &, const Args &, std::string &out) {
+		out += "tagtype: Artist\ntagtype: AlbumArtist\ntagtype: Album\ntagtype: Title\n";
+		out += "tagtype: Track\ntagtype: Date\ntagtype: Genre\n";
+	};
+	handlers["urlhandlers"] = [](Client &, const Args &, std::string &out) {
+		out += "handler: http://\n";
+	};
+	handlers["outputs"] = [](Client &, const Args &, std::string &out) {
+		out += "outputid: 0\noutputname: Null output\noutputenabled: 1\n";
+	};
+	handlers["enableoutput"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 1, 1);
+		emit(evOutput);
+	};
+	handlers["disableoutput"] = handlers["enableoutput"];
+	handlers["listplaylists"] = nothing;
+	handlers["replay_gain_status"] = [](Client &, const Args &, std::string &out) {
+		out += "replay_gain_mode: off\n";
+	};
+	handlers["update"] = [](Client &, const Args &, std::string &out) {
+		out += "updating_db: 1\n";
+		emit(evUpdate | evDatabase);
+	};
+	handlers["rescan"] = handlers["update"];
+
+	// database
+	handlers["listallinfo"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 0, 1);
+		list_directory(out, args.size() > 1 ? args[1] : "", true, true);
+	};
+	handlers["listall"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 0, 1);
+		list_directory(out, args.size() > 1 ? args[1] : "", true, false);
+	};
+	handlers["lsinfo"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 0, 1);
+		list_directory(out, args.size() > 1 ? args[1] : "", false, true);
+	};
+	handlers["search"] = [](Client &, const Args &args, std::string &out) {
+		for (auto i : match(args, 1, false))
+			print_song(out, db[i]);
+	};
+	handlers["find"] = [](Client &, const Args &args, std::string &out) {
+		for (auto i : match(args, 1, true))
+			print_song(out, db[i]);
+	};
+	handlers["list"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 1, 64);
+		Args filter(args);
+		// old syntax: list album ARTIST
+		if (args.size() == 3 && lowercase(args[1]) == "album")
+			filter.insert(filter.begin()+2, "artist");
+		const char *name = tag_name(args[1]);
+		std::set<std::string> values;
+		for (auto i : match(filter, 2, true))
+			values.insert(*get_tag(db[i], args[1]));
+		for (auto it = values.begin(); it != values.end(); ++it)
+			out += std::string(name) + ": " + *it + "\n";
+	};
+
+	// queue
+	handlers["add"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 1, 1);
+		if (const Song *s = find_song(args[1]))
+			add_to_queue(s - &db[0], -1);
+		else
+		{
+			auto range = directory_range(args[1]);
+			if (range.first == range.second)
+				throw Error(ackNoExist, "No such directory");
+			for (size_t i = range.first; i < range.second; ++i)
+				add_to_queue(i, -1);
+		}
+	};
+	handlers["addid"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 1, 2);
+		const Song *s = find_song(args[1]);
+		if (s == nullptr)
+			throw Error(ackNoExist, "No such song");
+		int pos = args.size() > 2 ? int(to_unsigned(args[2])) : -1;
+		if (pos > int(queue.size()))
+			throw Error(ackArg, "Bad song index");
+		out += "Id: " + std::to_string(add_to_queue(s - &db[0], pos)) + "\n";
+	};
+	handlers["delete"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 1, 1);
+		auto range = to_range(args[1]);
+		delete_range(range.first, range.second);
+	};
+	handlers["deleteid"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 1, 1);
+		int pos = find_id(to_unsigned(args[1]));
+		delete_range(pos, pos+1);
+	};
+	handlers["clear"] = [](Client &, const Args &, std::string &) {
+		queue.clear();
+		if (current >= 0)
+			play(-1);
+		queue_changed(0, 0);
+	};
+	handlers["move"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 2, 2);
+		auto range = to_range(args[1]);
+		move_range(range.first, range.second, to_unsigned(args[2]));
+	};
+	handlers["moveid"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 2, 2);
+		int pos = find_id(to_unsigned(args[1]));
+		move_range(pos, pos+1, to_unsigned(args[2]));
+	};
+	handlers["swap"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 2, 2);
+		unsigned a = to_unsigned(args[1]), b = to_unsigned(args[2]);
+		if (a >= queue.size() || b >= queue.size())
+			throw Error(ackArg, "Bad song index");
+		std::swap(queue[a], queue[b]);
+		if (current == int(a))
+			current = b;
+		else if (current == int(b))
+			current = a;
+		queue_changed(std::min(a, b), std::min(a, b)+1);
+		queue[std::max(a, b)].version = queue_version;
+	};
+	handlers["shuffle"] = [](Client &, const Args &, std::string &) {
+		static std::mt19937 rng(seed);
+		int current_id = current >= 0 ? queue[current].id : -1;
+		std::shuffle(queue.begin(), queue.end(), rng);
+		if (current_id >= 0)
+			current = find_id(current_id);
+		queue_changed(0, queue.size());
+	};
+	handlers["prioid"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 2, 2);
+		int pos = find_id(to_unsigned(args[2]));
+		queue[pos].prio = to_unsigned(args[1]);
+		queue_changed(pos, pos+1);
+	};
+	handlers["plchanges"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 1, 1);
+		unsigned version = to_unsigned(args[1]);
+		for (size_t i = 0; i < queue.size(); ++i)
+			if (queue[i].version > version)
+				print_queue_entry(out, i);
+	};
+	handlers["plchangesposid"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 1, 1);
+		unsigned version = to_unsigned(args[1]);
+		for (size_t i = 0; i < queue.size(); ++i)
+		{
+			if (queue[i].version > version)
+			{
+				out += "cpos: " + std::to_string(i) + "\n";
+				out += "Id: " + std::to_string(queue[i].id) + "\n";
+			}
+		}
+	};
+	handlers["playlistinfo"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 0, 1);
+		auto range = args.size() > 1 ? to_range(args[1]) : std::make_pair(0u, unsigned(queue.size()));
+		for (size_t i = range.first; i < range.second && i < queue.size(); ++i)
+			print_queue_entry(out, i);
+	};
+	handlers["playlistid"] = [](Client &, const Args &args, std::string &out) {
+		check_args(args, 0, 1);
+		if (args.size() > 1)
+			print_queue_entry(out, find_id(to_unsigned(args[1])));
+		else
+			for (size_t i = 0; i < queue.size(); ++i)
+				print_queue_entry(out, i);
+	};
+
+	// player
+	handlers["play"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 0, 1);
+		if (args.size() > 1)
+		{
+			int pos = to_int(args[1]);
+			if (pos >= int(queue.size()))
+				throw Error(ackArg, "Bad song index");
+			play(pos);
+		}
+		else if (state == State::Pause)
+		{
+			state = State::Play;
+			play_start = Clock::now();
+			emit(evPlayer);
+		}
+		else if (state == State::Stop)
+			play(current >= 0 ? current : 0);
+	};
+	handlers["playid"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 0, 1);
+		play(args.size() > 1 ? find_id(to_unsigned(args[1])) : 0);
+	};
+	handlers["pause"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 0, 1);
+		bool pause = args.size() > 1 ? to_bool(args[1]) : state == State::Play;
+		if (pause && state == State::Play)
+		{
+			elapsed_before_start = elapsed();
+			state = State::Pause;
+			emit(evPlayer);
+		}
+		else if (!pause && state == State::Pause)
+		{
+			state = State::Play;
+			play_start = Clock::now();
+			emit(evPlayer);
+		}
+	};
+	handlers["stop"] = [](Client &, const Args &, std::string &) {
+		state = State::Stop;
+		emit(evPlayer);
+	};
+	handlers["next"] = [](Client &, const Args &, std::string &) {
+		if (state != State::Stop)
+			play(current+1);
+	};
+	handlers["previous"] = [](Client &, const Args &, std::string &) {
+		if (state != State::Stop)
+			play(current > 0 ? current-1 : 0);
+	};
+	handlers["seek"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 2, 2);
+		int pos = to_int(args[1]);
+		if (pos < 0 || size_t(pos) >= queue.size())
+			throw Error(ackArg, "Bad song index");
+		play(pos);
+		elapsed_before_start = to_unsigned(args[2]);
+	};
+	handlers["setvol"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 1, 1);
+		volume = std::min(100u, to_unsigned(args[1]));
+		emit(evMixer);
+	};
+	auto option = [](bool &value) {
+		return [&value](Client &, const Args &args, std::string &) {
+			check_args(args, 1, 1);
+			value = to_bool(args[1]);
+			emit(evOptions);
+		};
+	};
+	handlers["repeat"] = option(repeat);
+	handlers["random"] = option(random_mode);
+	handlers["single"] = option(single);
+	handlers["consume"] = option(consume);
+	handlers["crossfade"] = [](Client &, const Args &args, std::string &) {
+		check_args(args, 1, 1);
+		crossfade = to_unsigned(args[1]);
+		emit(evOptions);
+	};
+
+	// idle
+	handlers["idle"] = [](Client &c, const Args &args, std::string &) {
+		c.idle_mask = 0;
+		for (size_t i = 1; i < args.size(); ++i)
+		{
+			auto name = std::find(std::begin(event_names), std::end(event_names), args[i]);
+			if (name == std::end(event_names))
+				throw Error(ackArg, "Unrecognized idle event: " + args[i]);
+			c.idle_mask |= 1 << (name - std::begin(event_names));
+		}
+		if (c.idle_mask == 0)
+			c.idle_mask = evAll;
+		c.idle = true;
+	};
+}
+
+/**********************************************************************/
+
+Args parse_line(const std::string &line)
+{
+	Args result;
+	size_t i = 0;
+	while (i < line.length())
+	{
+		while (i < line.length() && isspace(line[i]))
+			++i;
+		if (i == line.length())
+			break;
+		std::string arg;
+		if (line[i] == '"')
+		{
+			for (++i; i < line.length() && line[i] != '"'; ++i)
+			{
+				if (line[i] == '\\' && i+1 < line.length())
+					++i;
+				arg += line[i];
+			}
+			if (i == line.length())
+				throw Error(ackArg, "Missing closing '\"'");
+			++i;
+		}
+		else
+		{
+			for (; i < line.length() && !isspace(line[i]); ++i)
+				arg += line[i];
+		}
+		result.push_back(std::move(arg));
+	}
+	if (result.empty())
+		throw Error(ackUnknown, "No command given");
+	return result;
+}
+
+void send(Client &c, std::string data)
+{
+	Output o;
+	o.ready = Clock::now() + std::chrono::milliseconds(latency);
+	o.data = std::move(data);
+	c.output.push_back(std::move(o));
+}
+
+void send_events(Client &c)
+{
+	unsigned events = c.pending & c.idle_mask;
+	if (!c.idle || events == 0)
+		return;
+	std::string out;
+	for (size_t i = 0; i < sizeof(event_names)/sizeof(*event_names); ++i)
+		if (events & (1 << i))
+			out += std::string("changed: ") + event_names[i] + "\n";
+	out += "OK\n";
+	c.pending &= ~events;
+	c.idle = false;
+	send(c, std::move(out));
+}
+
+void emit(unsigned events)
+{
+	for (auto it = clients.begin(); it != clients.end(); ++it)
+		it->pending |= events;
+}
+
+// executes list of commands, returns false if one of them failed
+bool execute(Client &c, const std::vector<std::string> &commands, bool list_ok, std::string &out)
+{
+	for (size_t i = 0; i < commands.size(); ++i)
+	{
+		std::string name;
+		try
+		{
+			Args args = parse_line(commands[i]);
+			name = args[0];
+			auto handler = handlers.find(name);
+			if (handler == handlers.end())
+				throw Error(ackUnknown, "unknown command \"" + name + "\"");
+			if (c.in_list && name == "idle")
+				throw Error(ackArg, "idle is not allowed within command list");
+			handler->second(c, args, out);
+			if (list_ok)
+				out += "list_OK\n";
+		}
+		catch (Error &e)
+		{
+			char buf[32];
+			snprintf(buf, sizeof(buf), "ACK [%d@%zu] {", int(e.code), i);
+			out += buf + name + "} " + e.msg + "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+void process_line(Client &c, const std::string &line)
+{
+	if (c.idle)
+	{
+		if (line == "noidle")
+		{
+			c.idle = false;
+			send(c, "OK\n");
+		}
+		else
+			c.closing = true; // only noidle is allowed in idle mode
+		return;
+	}
+	if (line == "noidle")
+		return;
+	if (line == "close")
+	{
+		c.closing = true;
+		return;
+	}
+	if (c.in_list)
+	{
+		if (line == "command_list_end")
+		{
+			std::string out;
+			if (execute(c, c.list, c.list_ok, out))
+				out += "OK\n";
+			c.in_list = false;
+			c.list.clear();
+			send(c, std::move(out));
+		}
+		else
+			c.list.push_back(line);
+		return;
+	}
+	if (line == "command_list_begin" || line == "command_list_ok_begin")
+	{
+		c.in_list = true;
+		c.list_ok = line == "command_list_ok_begin";
+		return;
+	}
+	std::string out;
+	if (execute(c, std::vector<std::string>(1, line), false, out))
+	{
+		if (c.idle)
+		{
+			send_events(c);
+			return;
+		}
+		out += "OK\n";
+	}
+	send(c, std::move(out));
+}
+
+/**********************************************************************/
+
+// advances to the next song when the current one ends
+void update_player()
+{
+	if (state != State::Play || current < 0)
+		return;
+	if (elapsed() >= db[queue[current].song].duration)
+	{
+		if (single && !repeat)
+			play(-1);
+		else if (single)
+			play(current);
+		else if (size_t(current+1) < queue.size())
+			play(current+1);
+		else
+			play(repeat ? 0 : -1);
+	}
+}
+
+// Periodically changes an entry of the queue that stays at its position,
+// either its priority or tags of its song (as if the file was edited and
+// the database updated), so that clients can be checked for picking up
+// new versions of songs they already have.
+void update_scenario()
+{
+	if (scenario.empty() || Clock::now() < next_scenario_step)
+		return;
+	next_scenario_step = Clock::now() + std::chrono::milliseconds(scenario_interval);
+	if (queue.empty())
+		return;
+	static std::mt19937 rng(seed);
+	size_t pos = rng() % queue.size();
+	if (scenario == "prio")
+	{
+		queue[pos].prio = (queue[pos].prio+1) % 256;
+		queue_changed(pos, pos+1);
+	}
+	else if (scenario == "tags")
+	{
+		static unsigned edits = 0;
+		size_t song = queue[pos].song;
+		Song &s = db[song];
+		size_t suffix = s.title.find(" (edit ");
+		if (suffix != std::string::npos)
+			s.title.erase(suffix);
+		s.title += " (edit " + std::to_string(++edits) + ")";
+		s.mtime = db_update = time(nullptr);
+		// all entries of the song change
+		++queue_version;
+		for (auto it = queue.begin(); it != queue.end(); ++it)
+			if (it->song == song)
+				it->version = queue_version;
+		emit(evDatabase | evPlaylist);
+	}
+}
+
+bool read_input(Client &c)
+{
+	char buf[4096];
+	ssize_t n = read(c.fd, buf, sizeof(buf));
+	if (n <= 0)
+		return n < 0 && errno == EAGAIN;
+	c.input.append(buf, n);
+	size_t start = 0;
+	for (size_t nl; (nl = c.input.find('\n', start)) != std::string::npos; start = nl+1)
+		process_line(c, c.input.substr(start, nl-start));
+	c.input.erase(0, start);
+	return true;
+}
+
+bool write_output(Client &c)
+{
+	auto now = Clock::now();
+	while (!c.output.empty() && c.output.front().ready <= now)
+	{
+		const std::string &data = c.output.front().data;
+		ssize_t n = write(c.fd, data.c_str() + c.written, data.length() - c.written);
+		if (n < 0)
+			return errno == EAGAIN;
+		c.written += n;
+		if (c.written < data.length())
+			break;
+		c.written = 0;
+		c.output.pop_front();
+	}
+	return true;
+}
+
+int listen_socket()
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		perror("socket");
+		exit(1);
+	}
+	int flag = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, bind_address.c_str(), &addr.sin_addr) != 1)
+	{
+		std::cerr << "Invalid address: " << bind_address << "\n";
+		exit(1);
+	}
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 16) < 0)
+	{
+		perror("bind");
+		exit(1);
+	}
+	return fd;
+}
+
+void run(int server_fd)
+{
+	while (true)
+	{
+		update_player();
+		update_scenario();
+		for (auto it = clients.begin(); it != clients.end(); ++it)
+			send_events(*it);
+
+		// compute timeout to the first pending output or end of the song
+		auto now = Clock::now();
+		int timeout = -1;
+		auto update_timeout = [&](Clock::time_point t) {
+			int ms = std::max(0, int(std::chrono::duration_cast<std::chrono::milliseconds>(t - now).count()) + 1);
+			if (timeout < 0 || ms < timeout)
+				timeout = ms;
+		};
+		if (state == State::Play && current >= 0)
+			update_timeout(play_start + std::chrono::seconds(db[queue[current].song].duration - elapsed_before_start));
+		if (!scenario.empty())
+			update_timeout(next_scenario_step);
+
+		std::vector<pollfd> fds(1);
+		fds[0].fd = server_fd;
+		fds[0].events = POLLIN;
+		for (auto it = clients.begin(); it != clients.end(); ++it)
+		{
+			pollfd p;
+			p.fd = it->fd;
+			p.events = POLLIN;
+			p.revents = 0;
+			if (!it->output.empty())
+			{
+				if (it->output.front().ready <= now)
+					p.events |= POLLOUT;
+				else
+					update_timeout(it->output.front().ready);
+			}
+			fds.push_back(p);
+		}
+		if (poll(&fds[0], fds.size(), timeout) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			exit(1);
+		}
+
+		for (size_t i = 1; i < fds.size(); ++i)
+		{
+			Client &c = clients[i-1];
+			bool ok = true;
+			if (fds[i].revents & (POLLERR | POLLHUP))
+				ok = false;
+			if (ok && (fds[i].revents & POLLIN))
+				ok = read_input(c);
+			if (ok)
+				ok = write_output(c);
+			if (!ok || (c.closing && c.output.empty()))
+				c.fd = -c.fd - 1;
+		}
+		clients.erase(std::remove_if(clients.begin(), clients.end(), [](Client &c) {
+			if (c.fd < 0)
+				close(-c.fd - 1);
+			return c.fd < 0;
+		}), clients.end());
+
+		if (fds[0].revents & POLLIN)
+		{
+			int fd = accept(server_fd, nullptr, nullptr);
+			if (fd >= 0)
+			{
+				int flag = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				clients.push_back(Client(fd));
+				send(clients.back(), "OK MPD 0.19.0\n");
+			}
+		}
+	}
+}
+
+void usage(const char *name)
+{
+	std::cout << "Stand-in for MPD serving synthetic database, for benchmarking\n";
+	std::cout << "and testing ncmpcpp without real server and music collection.\n";
+	std::cout << "\n";
+	std::cout << "Usage: " << name << " [options]\n";
+	std::cout << "  --port N       port to listen on (default: 6600)\n";
+	std::cout << "  --bind ADDR    address to listen on (default: 127.0.0.1)\n";
+	std::cout << "  --songs N      number of songs in the database (default: 10000)\n";
+	std::cout << "  --queue N      number of songs initially in the queue (default: 0)\n";
+	std::cout << "  --latency MS   delay of each response in milliseconds (default: 0)\n";
+	std::cout << "  --seed N       seed used to generate the database (default: 1)\n";
+	std::cout << "  --scenario S   periodically change an entry of the queue in place:\n";
+	std::cout << "                 prio - its priority, tags - tags of its song\n";
+	std::cout << "  --interval MS  time between changes of the scenario (default: 1000)\n";
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string opt = argv[i];
+		if (opt == "--help" || opt == "-h" || i+1 == argc)
+		{
+			usage(argv[0]);
+			return opt == "--help" || opt == "-h" ? 0 : 1;
+		}
+		try
+		{
+			std::string value = argv[++i];
+			if (opt == "--port")
+				port = to_unsigned(value);
+			else if (opt == "--bind")
+				bind_address = value;
+			else if (opt == "--songs")
+				songs_count = to_unsigned(value);
+			else if (opt == "--queue")
+				queue_count = to_unsigned(value);
+			else if (opt == "--latency")
+				latency = to_unsigned(value);
+			else if (opt == "--seed")
+				seed = to_unsigned(value);
+			else if (opt == "--scenario" && (value == "prio" || value == "tags"))
+				scenario = value;
+			else if (opt == "--interval")
+				scenario_interval = to_unsigned(value);
+			else
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		catch (Error &e)
+		{
+			std::cerr << e.msg << "\n";
+			return 1;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	generate_database();
+	register_handlers();
+	for (size_t i = 0; i < queue_count && i < db.size(); ++i)
+		add_to_queue(i, -1);
+
+	next_scenario_step = Clock::now() + std::chrono::milliseconds(scenario_interval);
+	int server_fd = listen_socket();
+	std::cout << "Serving " << db.size() << " songs on " << bind_address << ":" << port;
+	if (latency > 0)
+		std::cout << " with " << latency << "ms latency";
+	std::cout << "\n";
+	run(server_fd);
+	return 0;
+}
@@ -0,0 +1,156 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+// Compares scans over items of NC::Menu in its former layout (every item
+// in a separate heap block behind a shared_ptr, with four bool flags)
+// with the current one (items stored by value in a vector, with flags
+// packed into one byte). Usage: menu_layout_benchmark [items]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include <boost/iterator/indirect_iterator.hpp>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const int Runs = 20;
+
+// same size as MPD::Song
+struct Value
+{
+	std::shared_ptr<const int> data;
+	size_t hash;
+};
+
+struct OldItem
+{
+	OldItem() : is_bold(false), is_selected(false), is_inactive(false), is_separator(false) { }
+
+	bool isSelected() const { return is_selected; }
+	void setSelected(bool selected) { is_selected = selected; }
+
+	Value value;
+	bool is_bold;
+	bool is_selected;
+	bool is_inactive;
+	bool is_separator;
+};
+
+struct NewItem
+{
+	NewItem() : flags(0) { }
+
+	bool isSelected() const { return flags & Selected; }
+	void setSelected(bool selected)
+	{
+		if (selected)
+			flags |= Selected;
+		else
+			flags &= ~Selected;
+	}
+
+	enum Flag { Bold = 1, Selected = 2, Inactive = 4, Separator = 8 };
+
+	Value value;
+	uint8_t flags;
+};
+
+typedef boost::indirect_iterator<
+	std::vector<std::shared_ptr<OldItem>>::iterator
+> OldIterator;
+
+template <typename Iterator>
+void selectAll(Iterator first, Iterator last)
+{
+	for (; first != last; ++first)
+		first->setSelected(true);
+}
+
+template <typename Iterator>
+void reverseSelection(Iterator first, Iterator last)
+{
+	for (; first != last; ++first)
+		first->setSelected(!first->isSelected());
+}
+
+template <typename Iterator>
+bool hasSelected(Iterator first, Iterator last)
+{
+	for (; first != last; ++first)
+		if (first->isSelected())
+			return true;
+	return false;
+}
+
+template <typename F>
+double averageTime(F f)
+{
+	auto start = Clock::now();
+	for (int i = 0; i < Runs; ++i)
+		f();
+	return std::chrono::duration<double, std::milli>(Clock::now()-start).count() / Runs;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 500000;
+
+	// allocations of items are interleaved with allocations of
+	// their values, as it happens when a playlist is loaded
+	std::vector<std::shared_ptr<OldItem>> old_items;
+	std::vector<NewItem> new_items(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		old_items.push_back(std::make_shared<OldItem>());
+		auto data = std::make_shared<const int>(i);
+		old_items.back()->value.data = data;
+		new_items[i].value.data = data;
+	}
+	OldIterator old_begin(old_items.begin()), old_end(old_items.end());
+	auto new_begin = new_items.begin(), new_end = new_items.end();
+
+	std::printf("select all:        old %.2fms, new %.2fms\n",
+		averageTime([&] { selectAll(old_begin, old_end); }),
+		averageTime([&] { selectAll(new_begin, new_end); })
+	);
+	std::printf("reverse selection: old %.2fms, new %.2fms\n",
+		averageTime([&] { reverseSelection(old_begin, old_end); }),
+		averageTime([&] { reverseSelection(new_begin, new_end); })
+	);
+	// with nothing selected the whole list is scanned
+	for (auto it = old_begin; it != old_end; ++it)
+		it->setSelected(false);
+	for (auto it = new_begin; it != new_end; ++it)
+		it->setSelected(false);
+	volatile bool result;
+	std::printf("hasSelected:       old %.2fms, new %.2fms\n",
+		averageTime([&] { result = hasSelected(old_begin, old_end); }),
+		averageTime([&] { result = hasSelected(new_begin, new_end); })
+	);
+	(void)result;
+	return 0;
+}
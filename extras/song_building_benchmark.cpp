@@ -0,0 +1,129 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+// Compares receiving songs of listallinfo as entities duplicated into
+// standalone songs (as MPD::Connection did) with building them directly
+// from the received pairs (as it does now). Counts calls to malloc, so it
+// relies on glibc. Usage: song_building_benchmark [host] [port]
+// e.g. against fake_mpd --songs 100000
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mpd/client.h>
+
+extern "C" void *__libc_malloc(size_t size);
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+size_t malloc_calls = 0;
+
+bool isEntityStart(const mpd_pair *pair)
+{
+	return strcmp(pair->name, "file") == 0
+	    || strcmp(pair->name, "directory") == 0
+	    || strcmp(pair->name, "playlist") == 0;
+}
+
+// returns number of received songs
+size_t receiveEntities(mpd_connection *connection)
+{
+	size_t songs = 0;
+	while (mpd_entity *entity = mpd_recv_entity(connection))
+	{
+		if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG)
+		{
+			mpd_song_free(mpd_song_dup(mpd_entity_get_song(entity)));
+			++songs;
+		}
+		mpd_entity_free(entity);
+	}
+	return songs;
+}
+
+size_t receivePairs(mpd_connection *connection)
+{
+	size_t songs = 0;
+	mpd_pair *pair = mpd_recv_pair(connection);
+	while (pair != nullptr)
+	{
+		if (strcmp(pair->name, "file") != 0)
+		{
+			mpd_return_pair(connection, pair);
+			pair = mpd_recv_pair(connection);
+			continue;
+		}
+		mpd_song *song = mpd_song_begin(pair);
+		mpd_return_pair(connection, pair);
+		while ((pair = mpd_recv_pair(connection)) != nullptr && !isEntityStart(pair))
+		{
+			mpd_song_feed(song, pair);
+			mpd_return_pair(connection, pair);
+		}
+		mpd_song_free(song);
+		++songs;
+	}
+	return songs;
+}
+
+void measure(mpd_connection *connection, const char *name, size_t (receive)(mpd_connection *))
+{
+	size_t calls = malloc_calls;
+	auto start = Clock::now();
+	mpd_send_list_all_meta(connection, "");
+	size_t songs = receive(connection);
+	mpd_response_finish(connection);
+	if (mpd_connection_get_error(connection) != MPD_ERROR_SUCCESS)
+	{
+		std::fprintf(stderr, "%s\n", mpd_connection_get_error_message(connection));
+		exit(1);
+	}
+	long time = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now()-start).count();
+	std::printf("%s: %zu songs in %ldms, %zu mallocs\n", name, songs, time, malloc_calls-calls);
+}
+
+}
+
+extern "C" void *malloc(size_t size)
+{
+	++malloc_calls;
+	return __libc_malloc(size);
+}
+
+int main(int argc, char **argv)
+{
+	const char *host = argc > 1 ? argv[1] : "localhost";
+	unsigned port = argc > 2 ? strtoul(argv[2], nullptr, 10) : 6600;
+	mpd_connection *connection = mpd_connection_new(host, port, 0);
+	if (mpd_connection_get_error(connection) != MPD_ERROR_SUCCESS)
+	{
+		std::fprintf(stderr, "%s\n", mpd_connection_get_error_message(connection));
+		return 1;
+	}
+	// first run warms up the server
+	measure(connection, "entities", receiveEntities);
+	measure(connection, "entities", receiveEntities);
+	measure(connection, "pairs", receivePairs);
+	mpd_connection_free(connection);
+	return 0;
+}
@@ -0,0 +1,158 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+// Compares sorting records of three tags with a locale based comparator
+// (as LocaleBasedSorting did) against sorting precomputed collation keys
+// of them (as sortByKeys does). Usage: sort_keys_benchmark [locale]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <locale>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::array<std::string, 3> Record;
+
+const char *words[] = {
+	"the", "Love", "night", "Żółw", "blue", "Åsa", "rock", "émile",
+	"dance", "song", "city", "fire", "Heart", "zero", "Ölfrid"
+};
+
+// leading "the " is ignored, as with ignore_leading_the
+size_t skipThe(const std::string &s)
+{
+	return s.length() >= 4
+	    && (s[0] | 32) == 't' && (s[1] | 32) == 'h' && (s[2] | 32) == 'e'
+	    && s[3] == ' ' ? 4 : 0;
+}
+
+std::vector<Record> generateRecords(size_t n, std::mt19937 &rng)
+{
+	std::vector<Record> records(n);
+	for (auto &record : records)
+	{
+		for (auto &field : record)
+		{
+			size_t length = 1 + rng()%4;
+			for (size_t i = 0; i < length; ++i)
+			{
+				if (i > 0)
+					field += ' ';
+				field += words[rng()%(sizeof(words)/sizeof(*words))];
+			}
+		}
+	}
+	return records;
+}
+
+long elapsed(Clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now()-start).count();
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	std::locale locale;
+	try
+	{
+		locale = std::locale(argc > 1 ? argv[1] : "");
+	}
+	catch (std::runtime_error &)
+	{
+		std::fprintf(stderr, "Locale %s is not available\n", argc > 1 ? argv[1] : "from environment");
+		return 1;
+	}
+	auto &collate = std::use_facet<std::collate<char>>(locale);
+	auto compare = [&collate](const std::string &a, const std::string &b) {
+		size_t a_offset = skipThe(a), b_offset = skipThe(b);
+		return collate.compare(
+			a.data()+a_offset, a.data()+a.length(),
+			b.data()+b_offset, b.data()+b.length()
+		);
+	};
+	auto less = [&compare](const Record &a, const Record &b) {
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			int result = compare(a[i], b[i]);
+			if (result != 0)
+				return result < 0;
+		}
+		return false;
+	};
+
+	std::mt19937 rng(1);
+	for (size_t n : { 10000, 100000, 300000 })
+	{
+		auto records = generateRecords(n, rng);
+
+		auto by_comparator = records;
+		auto start = Clock::now();
+		std::stable_sort(by_comparator.begin(), by_comparator.end(), less);
+		long comparator_time = elapsed(start);
+
+		auto by_keys = records;
+		start = Clock::now();
+		std::vector<std::pair<std::string, size_t>> keys;
+		keys.reserve(n);
+		for (auto &record : by_keys)
+		{
+			std::string key;
+			for (auto &field : record)
+			{
+				size_t offset = skipThe(field);
+				key += collate.transform(field.data()+offset, field.data()+field.length());
+				key += '\0';
+			}
+			keys.push_back(std::make_pair(std::move(key), keys.size()));
+		}
+		std::sort(keys.begin(), keys.end());
+		// permute records following cycles, as sortByKeys does
+		for (size_t i = 0; i < n; ++i)
+		{
+			for (size_t j = i;;)
+			{
+				size_t k = keys[j].second;
+				keys[j].second = j;
+				if (k == i)
+					break;
+				std::swap(by_keys[j], by_keys[k]);
+				j = k;
+			}
+		}
+		long keys_time = elapsed(start);
+
+		bool same = true;
+		for (size_t i = 0; i < n; ++i)
+			same &= !less(by_comparator[i], by_keys[i]) && !less(by_keys[i], by_comparator[i]);
+		std::printf("%zu items: comparator %ldms, keys %ldms, same order: %s\n",
+			n, comparator_time, keys_time, same ? "yes" : "no"
+		);
+	}
+	return 0;
+}
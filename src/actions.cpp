@@ -46,6 +46,7 @@
 #include "help.h"
 #include "media_library.h"
 #include "lastfm.h"
+#include "library.h"
 #include "lyrics.h"
 #include "playlist.h"
 #include "playlist_editor.h"
@@ -915,14 +916,18 @@ void MoveSelectedItemsTo::run()
 	if (myScreen == myPlaylist)
 	{
 		if (!myPlaylist->main().empty())
-			moveSelectedItemsTo(myPlaylist->main(), boost::bind(&MPD::Connection::Move, _1, _2, _3));
+			moveSelectedItemsTo(myPlaylist->main(), boost::bind(&MPD::Connection::MoveRange, _1, _2, _3, _4));
 	}
 	else
 	{
 		assert(!myPlaylistEditor->Playlists.empty());
 		std::string playlist = myPlaylistEditor->Playlists.current()->value().path();
+		// stored playlists can't move ranges of songs at once
 		auto move_fun = boost::bind(&MPD::Connection::PlaylistMove, _1, playlist, _2, _3);
-		moveSelectedItemsTo(myPlaylistEditor->Content, move_fun);
+		auto move_range_fun = [&move_fun](MPD::Connection *mpd, unsigned start, unsigned end, unsigned to) {
+			moveRange(mpd, move_fun, start, end, to);
+		};
+		moveSelectedItemsTo(myPlaylistEditor->Content, move_range_fun);
 	}
 }
 
@@ -1199,6 +1204,16 @@ void StartSearching::run()
 	mySearcher->enterPressed();
 }
 
+bool CancelSearching::canBeRun() const
+{
+	return myScreen == mySearcher && mySearcher->isSearching();
+}
+
+void CancelSearching::run()
+{
+	mySearcher->stopSearching();
+}
+
 bool SaveTagChanges::canBeRun() const
 {
 #	ifdef HAVE_TAGLIB_H
@@ -1995,7 +2010,7 @@ void AddRandomItems::run()
 		Statusbar::put() << "Number of random " << tag_type_str << "s: ";
 		number = fromString<unsigned>(wFooter->prompt());
 	}
-	if (number && (rnd_type == 's' ? Mpd.AddRandomSongs(number) : Mpd.AddRandomTag(tag_type, number)))
+	if (number && (rnd_type == 's' ? Mpd.AddRandomSongs(number, Library::songs()) : Mpd.AddRandomTag(tag_type, number)))
 	{
 		Statusbar::printf("%1% random %2%%3% added to playlist",
 			number, tag_type_str, number == 1 ? "" : "s"
@@ -2031,7 +2046,7 @@ void ToggleBrowserSortMode::run()
 	if (Config.browser_sort_mode != SortMode::NoOp)
 	{
 		size_t sort_offset = myBrowser->inRootDirectory() ? 0 : 1;
-		std::sort(myBrowser->main().begin()+sort_offset, myBrowser->main().end(),
+		sortByKeys(myBrowser->main().begin()+sort_offset, myBrowser->main().end(),
 			LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the, Config.browser_sort_mode)
 		);
 	}
@@ -2524,6 +2539,7 @@ void populateActions()
 	insert_action(new Actions::Shuffle());
 	insert_action(new Actions::ToggleRandom());
 	insert_action(new Actions::StartSearching());
+	insert_action(new Actions::CancelSearching());
 	insert_action(new Actions::SaveTagChanges());
 	insert_action(new Actions::ToggleSingle());
 	insert_action(new Actions::ToggleConsume());
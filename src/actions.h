@@ -41,7 +41,7 @@ enum class Type
 	SeekForward, SeekBackward, ToggleDisplayMode, ToggleSeparatorsBetweenAlbums,
 	ToggleLyricsFetcher, ToggleFetchingLyricsInBackground, TogglePlayingSongCentering,
 	UpdateDatabase, JumpToPlayingSong, ToggleRepeat, Shuffle, ToggleRandom,
-	StartSearching, SaveTagChanges, ToggleSingle, ToggleConsume, ToggleCrossfade,
+	StartSearching, CancelSearching, SaveTagChanges, ToggleSingle, ToggleConsume, ToggleCrossfade,
 	SetCrossfade, SetVolume, EditSong, EditLibraryTag, EditLibraryAlbum, EditDirectoryName,
 	EditPlaylistName, EditLyrics, JumpToBrowser, JumpToMediaLibrary,
 	JumpToPlaylistEditor, ToggleScreenLock, JumpToTagEditor, JumpToPositionInSong,
@@ -562,6 +562,15 @@ protected:
 	virtual void run();
 };
 
+struct CancelSearching : public BaseAction
+{
+	CancelSearching() : BaseAction(Type::CancelSearching, "cancel_searching") { }
+	
+protected:
+	virtual bool canBeRun() const;
+	virtual void run();
+};
+
 struct SaveTagChanges : public BaseAction
 {
 	SaveTagChanges() : BaseAction(Type::SaveTagChanges, "save_tag_changes") { }
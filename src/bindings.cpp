@@ -456,6 +456,7 @@ void BindingsConfiguration::generateDefaults()
 	if (notBound(k = stringToKey("y")))
 	{
 		bind(k, Actions::Type::SaveTagChanges);
+		bind(k, Actions::Type::CancelSearching);
 		bind(k, Actions::Type::StartSearching);
 		bind(k, Actions::Type::ToggleSingle);
 	}
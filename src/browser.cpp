@@ -68,6 +68,7 @@ void clearDirectory(const std::string &directory);
 
 std::string itemToString(const MPD::Item &item);
 bool browserEntryMatcher(const boost::regex &rx, const MPD::Item &item, bool filter);
+int browserEntryScore(const FuzzyPattern &pattern, const MPD::Item &item);
 
 }
 
@@ -106,7 +107,7 @@ void Browser::resize()
 void Browser::switchTo()
 {
 	SwitchTo::execute(this);
-	markSongsInPlaylist(proxySongList());
+	markSongsInPlaylist();
 	drawHeader();
 }
 
@@ -250,10 +251,15 @@ bool Browser::allowsSearching()
 
 void Browser::setSearchConstraint(const std::string &constraint)
 {
-	m_search_predicate = RegexFilter<MPD::Item>(
-		boost::regex(constraint, Config.regex_type),
-		boost::bind(browserEntryMatcher, _1, _2, false)
-	);
+	if (Config.fuzzy_find)
+		m_search_predicate = RegexFilter<MPD::Item>(
+			FuzzyPattern(constraint), browserEntryScore
+		);
+	else
+		m_search_predicate = RegexFilter<MPD::Item>(
+			boost::regex(constraint, Config.regex_type),
+			boost::bind(browserEntryMatcher, _1, _2, false)
+		);
 }
 
 void Browser::clearConstraint()
@@ -369,10 +375,16 @@ void Browser::locateSong(const MPD::Song &s)
 		w.highlight(it-begin);
 }
 
+void Browser::markSongsInPlaylist()
+{
+	m_playlist_marker.mark(proxySongList());
+}
+
 void Browser::getDirectory(std::string directory)
 {
 	m_scroll_beginning = 0;
 	w.clear();
+	m_playlist_marker.invalidate();
 
 	// reset the position if we change directories
 	if (m_current_directory != directory)
@@ -403,7 +415,7 @@ void Browser::getDirectory(std::string directory)
 	// sort items
 	if (Config.browser_sort_mode != SortMode::NoOp)
 	{
-		std::sort(items.begin(), items.end(),
+		sortByKeys(items.begin(), items.end(),
 			LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the, Config.browser_sort_mode)
 		);
 	}
@@ -609,7 +621,7 @@ void getLocalDirectoryRecursively(std::vector<MPD::Song> &songs, const std::stri
 
 	if (Config.browser_sort_mode != SortMode::NoOp)
 	{
-		std::sort(songs.begin()+sort_offset, songs.end(),
+		sortByKeys(songs.begin()+sort_offset, songs.end(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the)
 		);
 	}
@@ -663,4 +675,13 @@ bool browserEntryMatcher(const boost::regex &rx, const MPD::Item &item, bool fil
 	return boost::regex_search(itemToString(item), rx);
 }
 
+int browserEntryScore(const FuzzyPattern &pattern, const MPD::Item &item)
+{
+	if (isItemParentDirectory(item))
+		return -1;
+	if (item.type() == MPD::Item::Type::Song)
+		return fuzzySongScore(pattern, item.song());
+	return pattern.score(itemToString(item));
+}
+
 }
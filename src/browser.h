@@ -68,6 +68,7 @@ struct Browser: Screen<NC::Menu<MPD::Item>>, HasSongs, Searchable, Tabbable
 	void getDirectory(std::string directory);
 	void changeBrowseMode();
 	void remove(const MPD::Item &item);
+	void markSongsInPlaylist();
 
 	static void fetchSupportedExtensions();
 
@@ -79,6 +80,7 @@ private:
 	size_t m_scroll_beginning;
 	std::string m_current_directory;
 	RegexFilter<MPD::Item> m_search_predicate;
+	SongsInPlaylistMarker m_playlist_marker;
 };
 
 extern Browser *myBrowser;
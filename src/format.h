@@ -22,6 +22,7 @@
 #define NCMPCPP_HAVE_FORMAT_H
 
 #include <boost/variant.hpp>
+#include <typeinfo>
 
 #include "menu.h"
 #include "song.h"
@@ -52,14 +53,17 @@ struct OutputSwitch { };
 struct SongTag
 {
 	SongTag(MPD::Song::GetFunction function_, unsigned delimiter_ = 0)
-	: m_function(function_), m_delimiter(delimiter_)
+	: m_function(function_), m_view(MPD::Song::toViewFunction(function_))
+	, m_delimiter(delimiter_)
 	{ }
 
 	MPD::Song::GetFunction function() const { return m_function; }
+	MPD::Song::ViewFunction view() const { return m_view; }
 	unsigned delimiter() const { return m_delimiter; }
 
 private:
 	MPD::Song::GetFunction m_function;
+	MPD::Song::ViewFunction m_view;
 	unsigned m_delimiter;
 };
 
@@ -99,6 +103,7 @@ struct Printer: boost::static_visitor<bool>
 	Printer(OutputT &os, const MPD::Song *song, SecondOutputT *second_os, const unsigned flags)
 	: m_output(os)
 	, m_song(song)
+	, m_song_views(song != nullptr && typeid(*song) == typeid(MPD::Song))
 	, m_output_switched(false)
 	, m_second_os(second_os)
 	, m_no_output(0)
@@ -137,9 +142,14 @@ struct Printer: boost::static_visitor<bool>
 		StringT tags;
 		if (m_flags & Flags::Tag && m_song != nullptr)
 		{
-			tags = convertString<CharT, char>::apply(
-				m_song->getTags(st.function())
-			);
+			if (m_song_views && st.view() != nullptr)
+				tags = convertString<CharT, char>::apply(
+					m_song->viewTags(st.view(), m_tags_buffer)
+				);
+			else
+				tags = convertString<CharT, char>::apply(
+					m_song->getTags(st.function())
+				);
 		}
 		if (!tags.empty())
 		{
@@ -233,6 +243,9 @@ private:
 
 	OutputT &m_output;
 	const MPD::Song *m_song;
+	// MutableSong overrides getters, so views can't be used with it
+	const bool m_song_views;
+	std::string m_tags_buffer;
 
 	bool m_output_switched;
 	SecondOutputT *m_second_os;
@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <time.h>
+#include <typeinfo>
 
 #include "helpers.h"
 #include "playlist.h"
@@ -31,19 +32,21 @@ bool addSongToPlaylist(const MPD::Song &s, bool play, int position)
 	if (Config.space_add_mode == SpaceAddMode::AddRemove && myPlaylist->checkForSong(s))
 	{
 		auto &w = myPlaylist->main();
+		auto positions = myPlaylist->songPositions(s);
+		assert(!positions.empty());
 		if (play)
 		{
-			auto song = std::find(w.beginV(), w.endV(), s);
-			assert(song != w.endV());
-			Mpd.PlayID(song->getID());
+			auto first = std::min_element(positions.begin(), positions.end());
+			Mpd.PlayID(w[*first].value().getID());
 			result = true;
 		}
 		else
 		{
+			// delete from the end so that positions of the rest stay valid
+			std::sort(positions.begin(), positions.end(), std::greater<size_t>());
 			Mpd.StartCommandsList();
-			for (auto it = w.rbeginV(); it != w.rendV(); ++it)
-				if (*it == s)
-					Mpd.Delete(it->getPosition());
+			for (auto it = positions.begin(); it != positions.end(); ++it)
+				Mpd.Delete(*it);
 			Mpd.CommitCommandsList();
 			// we return false in this case
 		}
@@ -85,12 +88,28 @@ std::string Timestamp(time_t t)
 	return result;
 }
 
-void markSongsInPlaylist(ProxySongList pl)
+int fuzzySongScore(const FuzzyPattern &pattern, const MPD::Song &s)
 {
-	size_t list_size = pl.size();
-	for (size_t i = 0; i < list_size; ++i)
-		if (auto s = pl.getSong(i))
-			pl.setBold(i, myPlaylist->checkForSong(*s));
+	std::string tags[3];
+	boost::string_ref views[3];
+	// views don't see tags modified in MPD::MutableSong
+	if (typeid(s) != typeid(MPD::Song))
+	{
+		tags[0] = s.getArtist();
+		tags[1] = s.getAlbum();
+		tags[2] = s.getTitle();
+		std::copy(std::begin(tags), std::end(tags), views);
+	}
+	else
+	{
+		views[0] = s.viewArtist();
+		views[1] = s.viewAlbum();
+		views[2] = s.viewTitle();
+	}
+	// songs without title are known by their filename
+	if (views[2].empty())
+		views[2] = s.viewName();
+	return pattern.score(std::begin(views), std::end(views));
 }
 
 std::wstring Scroller(const std::wstring &str, size_t &pos, size_t width)
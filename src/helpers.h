@@ -26,6 +26,7 @@
 #include "screen.h"
 #include "settings.h"
 #include "status.h"
+#include "utility/fuzzy_match.h"
 #include "utility/string.h"
 #include "utility/type_conversions.h"
 #include "utility/wide_string.h"
@@ -46,12 +47,59 @@ Iterator wrappedSearch(Iterator begin, Iterator current, Iterator end,
 	return it;
 }
 
+// Items are ordered by their score, the ones with equal scores by position.
+// Searching forward goes to the next worse matching item, searching
+// backward to the next better one. Without an item to start from,
+// the best matching one is chosen.
+template <typename ItemT, typename PredicateT>
+bool rankedSearch(NC::Menu<ItemT> &m, const PredicateT &pred,
+                  SearchDirection direction, bool wrap, bool skip_current)
+{
+	// the greater the key, the better the item matches
+	typedef std::pair<int, ptrdiff_t> Key;
+	const Key none(-1, 0);
+	Key best = none, worst = none, next = none, previous = none;
+	Key current = none;
+	if (skip_current && !m.empty())
+		current = Key(pred.score(*m.current()), -ptrdiff_t(m.choice()));
+	for (auto it = m.begin(); it != m.end(); ++it)
+	{
+		if (it->isSeparator() || it->isInactive())
+			continue;
+		Key key(pred.score(*it), -(it-m.begin()));
+		if (key.first < 0)
+			continue;
+		if (best == none || key > best)
+			best = key;
+		if (worst == none || key < worst)
+			worst = key;
+		if (key < current && (next == none || key > next))
+			next = key;
+		if (key > current && (previous == none || key < previous))
+			previous = key;
+	}
+	
+	Key found = none;
+	if (current.first < 0)
+		found = best;
+	else if (direction == SearchDirection::Forward)
+		found = next != none ? next : (wrap ? best : none);
+	else
+		found = previous != none ? previous : (wrap ? worst : none);
+	if (found == none)
+		return false;
+	m.highlight(-found.second);
+	return true;
+}
+
 template <typename ItemT, typename PredicateT>
 bool search(NC::Menu<ItemT> &m, const PredicateT &pred,
             SearchDirection direction, bool wrap, bool skip_current)
 {
 	bool result = false;
-	if (pred.defined())
+	if (pred.defined() && pred.ranked())
+		result = rankedSearch(m, pred, direction, wrap, skip_current);
+	else if (pred.defined())
 	{
 		switch (direction)
 		{
@@ -168,8 +216,37 @@ void reverseSelectionHelper(Iterator first, Iterator last)
 		first->setSelected(!first->isSelected());
 }
 
+// moves items [start, end) so that the first of them ends up at position
+// to using single item moves, either of the items in range or of the ones
+// between range and its destination, whichever there are less of.
+template <typename F>
+void moveRange(MPD::Connection *mpd, F move_fun, unsigned start, unsigned end, unsigned to)
+{
+	unsigned length = end - start;
+	if (to > start) // move down
+	{
+		unsigned distance = to - start;
+		if (length <= distance)
+			for (unsigned i = length; i > 0; --i)
+				move_fun(mpd, start+i-1, to+i-1);
+		else
+			for (unsigned i = 0; i < distance; ++i)
+				move_fun(mpd, end+i, start+i);
+	}
+	else if (to < start) // move up
+	{
+		unsigned distance = start - to;
+		if (length <= distance)
+			for (unsigned i = 0; i < length; ++i)
+				move_fun(mpd, start+i, to+i);
+		else
+			for (unsigned i = 0; i < distance; ++i)
+				move_fun(mpd, start-1-i, end-1-i);
+	}
+}
+
 template <typename F>
-void moveSelectedItemsUp(NC::Menu<MPD::Song> &m, F swap_fun)
+void moveSelectedItemsUp(NC::Menu<MPD::Song> &m, F move_fun)
 {
 	if (m.choice() > 0)
 		selectCurrentIfNoneSelected(m);
@@ -177,9 +254,17 @@ void moveSelectedItemsUp(NC::Menu<MPD::Song> &m, F swap_fun)
 	auto begin = m.begin();
 	if (!list.empty() && list.front() != m.begin())
 	{
+		// instead of moving each selected item up, move the item
+		// above each run of adjacent selected items below it
 		Mpd.StartCommandsList();
-		for (auto it = list.begin(); it != list.end(); ++it)
-			swap_fun(&Mpd, *it - begin, *it - begin - 1);
+		for (auto it = list.begin(); it != list.end();)
+		{
+			auto run_end = it+1;
+			while (run_end != list.end() && *run_end == *(run_end-1)+1)
+				++run_end;
+			move_fun(&Mpd, *it - begin - 1, *(run_end-1) - begin);
+			it = run_end;
+		}
 		Mpd.CommitCommandsList();
 		if (list.size() > 1)
 		{
@@ -201,7 +286,7 @@ void moveSelectedItemsUp(NC::Menu<MPD::Song> &m, F swap_fun)
 }
 
 template <typename F>
-void moveSelectedItemsDown(NC::Menu<MPD::Song> &m, F swap_fun)
+void moveSelectedItemsDown(NC::Menu<MPD::Song> &m, F move_fun)
 {
 	if (m.choice() < m.size()-1)
 		selectCurrentIfNoneSelected(m);
@@ -209,9 +294,17 @@ void moveSelectedItemsDown(NC::Menu<MPD::Song> &m, F swap_fun)
 	auto begin = m.begin() + 1; // reverse iterators add 1, so we need to cancel it
 	if (!list.empty() && list.front() != m.rbegin())
 	{
+		// instead of moving each selected item down, move the item
+		// below each run of adjacent selected items above it
 		Mpd.StartCommandsList();
-		for (auto it = list.begin(); it != list.end(); ++it)
-			swap_fun(&Mpd, it->base() - begin, it->base() - begin + 1);
+		for (auto it = list.begin(); it != list.end();)
+		{
+			auto run_end = it+1;
+			while (run_end != list.end() && *run_end == *(run_end-1)+1)
+				++run_end;
+			move_fun(&Mpd, it->base() - begin + 1, (run_end-1)->base() - begin);
+			it = run_end;
+		}
 		Mpd.CommitCommandsList();
 		if (list.size() > 1)
 		{
@@ -232,8 +325,10 @@ void moveSelectedItemsDown(NC::Menu<MPD::Song> &m, F swap_fun)
 	}
 }
 
+// move_range_fun moves items [start, end) so that the
+// first of them ends up at given position, see moveRange.
 template <typename F>
-void moveSelectedItemsTo(NC::Menu<MPD::Song> &m, F move_fun)
+void moveSelectedItemsTo(NC::Menu<MPD::Song> &m, F move_range_fun)
 {
 	// FIXME: make it not look like shit
 	auto cur_ptr = &m.current()->value();
@@ -253,34 +348,41 @@ void moveSelectedItemsTo(NC::Menu<MPD::Song> &m, F move_fun)
 	if (pos >= (list.front() - begin) && pos <= (list.back() - begin))
 		return;
 	int diff = pos - (list.front() - begin);
+	// split selected items into runs of adjacent ones, each of them
+	// can then be moved to its destination with a single command
+	std::vector<std::pair<size_t, size_t>> runs;
+	for (auto it = list.begin(); it != list.end(); ++it)
+	{
+		if (!runs.empty() && size_t(*it - begin) == runs.back().second)
+			++runs.back().second;
+		else
+			runs.push_back(std::make_pair(*it - begin, *it - begin + 1));
+	}
 	Mpd.StartCommandsList();
 	if (diff > 0) // move down
 	{
 		pos -= list.size();
-		size_t i = list.size()-1;
-		for (auto it = list.rbegin(); it != list.rend(); ++it, --i)
-			move_fun(&Mpd, *it - begin, pos+i);
-		Mpd.CommitCommandsList();
-		i = list.size()-1;
-		for (auto it = list.rbegin(); it != list.rend(); ++it, --i)
+		size_t i = list.size();
+		for (auto run = runs.rbegin(); run != runs.rend(); ++run)
 		{
-			(*it)->setSelected(false);
-			m[pos+i].setSelected(true);
+			i -= run->second - run->first;
+			move_range_fun(&Mpd, run->first, run->second, pos+i);
 		}
 	}
-	else if (diff < 0) // move up
+	else // move up
 	{
 		size_t i = 0;
-		for (auto it = list.begin(); it != list.end(); ++it, ++i)
-			move_fun(&Mpd, *it - begin, pos+i);
-		Mpd.CommitCommandsList();
-		i = 0;
-		for (auto it = list.begin(); it != list.end(); ++it, ++i)
+		for (auto run = runs.begin(); run != runs.end(); ++run)
 		{
-			(*it)->setSelected(false);
-			m[pos+i].setSelected(true);
+			move_range_fun(&Mpd, run->first, run->second, pos+i);
+			i += run->second - run->first;
 		}
 	}
+	Mpd.CommitCommandsList();
+	for (auto it = list.begin(); it != list.end(); ++it)
+		(*it)->setSelected(false);
+	for (size_t i = 0; i < list.size(); ++i)
+		m[pos+i].setSelected(true);
 }
 
 template <typename F>
@@ -386,49 +488,41 @@ template <typename SongIterator>
 bool addSongsToPlaylist(SongIterator first, SongIterator last, bool play, int position)
 {
 	bool result = true;
-	auto addSongNoError = [&](SongIterator song) -> int {
+	int id = -1;
+	// all songs are sent within one commands list. if adding one of them
+	// fails, mpd doesn't execute the rest, so we skip it and send them again.
+	while (first != last)
+	{
+		std::vector<boost::future<int>> ids;
+		Mpd.StartCommandsList();
+		for (auto song = first; song != last; ++song)
+		{
+			int song_pos = position < 0 ? -1 : position + ids.size();
+			ids.push_back(Mpd.AddSongAsync(*song, song_pos));
+		}
 		try
 		{
-			return Mpd.AddSong(*song, position);
+			Mpd.CommitCommandsList();
 		}
 		catch (MPD::ServerError &e)
 		{
 			Status::handleServerError(e);
 			result = false;
-			return -1;
-		}
-	};
-
-	if (last-first >= 1)
-	{
-		int id;
-		while (true)
-		{
-			id = addSongNoError(first);
-			if (id >= 0)
-				break;
-			++first;
-			if (first == last)
-				return result;
 		}
-
-		if (position == -1)
+		for (auto it = ids.begin(); it != ids.end(); ++it)
 		{
 			++first;
-			for(; first != last; ++first)
-				addSongNoError(first);
-		}
-		else
-		{
-			++position;
-			--last;
-			for (; first != last; --last)
-				addSongNoError(last);
+			if (it->has_exception())
+				break;
+			int song_id = it->get();
+			if (id < 0)
+				id = song_id;
+			if (position >= 0)
+				++position;
 		}
-		if (play)
-			Mpd.PlayID(id);
 	}
-
+	if (play && id >= 0)
+		Mpd.PlayID(id);
 	return result;
 }
 
@@ -443,7 +537,8 @@ std::string timeFormat(const char *format, time_t t);
 
 std::string Timestamp(time_t t);
 
-void markSongsInPlaylist(ProxySongList pl);
+// scores artist, album and title of the song
+int fuzzySongScore(const FuzzyPattern &pattern, const MPD::Song &s);
 
 std::wstring Scroller(const std::wstring &str, size_t &pos, size_t width);
 void writeCyclicBuffer(const NC::WBuffer &buf, NC::Window &w, size_t &start_pos,
@@ -0,0 +1,818 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include "config.h"
+
+#include <algorithm>
+#include <boost/thread/future.hpp>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "library.h"
+#include "mpdpp.h"
+#include "settings.h"
+
+namespace {
+
+// increase if format of the snapshot changes
+const uint32_t SnapshotVersion = 1;
+const char SnapshotMagic[8] = { 'n', 'c', 'm', 'p', 'c', 'p', 'p', 'L' };
+
+struct Key
+{
+	Key() : port(0), dbUpdate(0) { }
+
+	bool operator==(const Key &rhs) const
+	{
+		return host == rhs.host && port == rhs.port && dbUpdate == rhs.dbUpdate;
+	}
+
+	std::string host;
+	uint32_t port;
+	uint64_t dbUpdate;
+};
+
+bool library_loaded = false;
+Key library_key;
+std::vector<MPD::Song> library;
+
+// trigram index of the library, built on demand
+bool index_built = false;
+std::unordered_map<uint32_t, std::vector<uint32_t>> index_postings;
+
+// songs grouped by tag, built on demand
+bool songs_by_tag_built = false;
+mpd_tag_type songs_by_tag_type;
+Library::SongsByTag songs_by_tag;
+
+// songs are handed over from the background in batches of this size
+const size_t BackgroundBatchSize = 1024;
+
+// modification times of files are fetched for this many directories at once
+const size_t MTimesBatchSize = 256;
+
+struct BackgroundLoad
+{
+	Key key;
+	boost::future<void> worker;
+	
+	// songs received by the worker, but not yet added to the library
+	std::mutex mutex;
+	std::vector<MPD::Song> received;
+};
+
+std::shared_ptr<BackgroundLoad> background_load;
+
+const MPD::Song::ViewFunction IndexedTags[] = {
+	&MPD::Song::viewArtist,
+	&MPD::Song::viewAlbumArtist,
+	&MPD::Song::viewTitle,
+	&MPD::Song::viewAlbum,
+	&MPD::Song::viewName,
+	&MPD::Song::viewComposer,
+	&MPD::Song::viewPerformer,
+	&MPD::Song::viewGenre,
+	&MPD::Song::viewDate,
+	&MPD::Song::viewComment
+};
+
+std::string snapshotPath(const Key &key)
+{
+	std::string name = "library-" + key.host + "-" + std::to_string(key.port);
+	// host may also be a path to unix socket
+	for (auto &c : name)
+		if (!isalnum(c) && c != '-' && c != '.')
+			c = '_';
+	return Config.ncmpcpp_directory + name;
+}
+
+/**********************************************************************/
+
+template <typename ValueT>
+void write(std::ostream &os, ValueT value)
+{
+	os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void writeString(std::ostream &os, boost::string_ref s)
+{
+	write<uint32_t>(os, s.size());
+	os.write(s.data(), s.size());
+}
+
+void saveSnapshot(const Key &key, const std::vector<MPD::Song> &songs)
+{
+	std::string path = snapshotPath(key);
+	std::string tmp_path = path + ".tmp";
+	std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+	if (!f.is_open())
+		return;
+	f.write(SnapshotMagic, sizeof(SnapshotMagic));
+	write(f, SnapshotVersion);
+	writeString(f, key.host);
+	write(f, key.port);
+	write(f, key.dbUpdate);
+
+	// tag values are stored once and referred to by their indices
+	std::unordered_map<const std::string *, uint32_t> indices;
+	std::vector<const std::string *> values;
+	for (const auto &s : songs)
+		for (const auto &tag : s.getInternedTags())
+			if (indices.insert(std::make_pair(tag.value, values.size())).second)
+				values.push_back(tag.value);
+	write<uint32_t>(f, values.size());
+	for (const auto &value : values)
+		writeString(f, *value);
+
+	write<uint32_t>(f, songs.size());
+	for (const auto &s : songs)
+	{
+		writeString(f, s.viewURI());
+		write<uint32_t>(f, s.getDuration());
+		write<int64_t>(f, s.getMTime());
+		const auto &tags = s.getInternedTags();
+		write<uint32_t>(f, tags.size());
+		for (const auto &tag : tags)
+		{
+			write<uint32_t>(f, tag.type);
+			write<uint32_t>(f, indices[tag.value]);
+		}
+	}
+
+	f.close();
+	if (f.good())
+		rename(tmp_path.c_str(), path.c_str());
+	else
+		remove(tmp_path.c_str());
+}
+
+/**********************************************************************/
+
+struct Reader
+{
+	Reader(const char *begin, const char *end)
+	: m_pos(begin), m_end(end)
+	{ }
+
+	template <typename ValueT>
+	ValueT read()
+	{
+		ValueT value;
+		require(sizeof(value));
+		memcpy(&value, m_pos, sizeof(value));
+		m_pos += sizeof(value);
+		return value;
+	}
+
+	boost::string_ref readString()
+	{
+		uint32_t length = read<uint32_t>();
+		require(length);
+		boost::string_ref result(m_pos, length);
+		m_pos += length;
+		return result;
+	}
+
+	size_t remaining() const { return m_end - m_pos; }
+
+private:
+	void require(size_t length) const
+	{
+		if (remaining() < length)
+			throw std::runtime_error("library snapshot is truncated");
+	}
+
+	const char *m_pos;
+	const char *m_end;
+};
+
+bool parseSnapshot(Reader &r, const Key &key, std::vector<MPD::Song> &songs)
+{
+	// counts are checked against these before anything is allocated
+	const size_t min_value_size = sizeof(uint32_t);
+	const size_t min_song_size = 3*sizeof(uint32_t) + sizeof(int64_t);
+	const size_t tag_size = 2*sizeof(uint32_t);
+
+	boost::string_ref magic(SnapshotMagic, sizeof(SnapshotMagic));
+	for (size_t i = 0; i < magic.size(); ++i)
+		if (r.read<char>() != magic[i])
+			return false;
+	if (r.read<uint32_t>() != SnapshotVersion
+	||  r.readString() != key.host
+	||  r.read<uint32_t>() != key.port
+	||  r.read<uint64_t>() != key.dbUpdate)
+		return false;
+
+	uint32_t values_count = r.read<uint32_t>();
+	if (values_count > r.remaining() / min_value_size)
+		return false;
+	std::vector<const std::string *> values(values_count);
+	for (auto &value : values)
+		value = MPD::Song::intern(r.readString());
+
+	uint32_t songs_count = r.read<uint32_t>();
+	if (songs_count > r.remaining() / min_song_size)
+		return false;
+	songs.reserve(songs_count);
+	for (uint32_t i = 0; i < songs_count; ++i)
+	{
+		std::string uri = r.readString().to_string();
+		unsigned duration = r.read<uint32_t>();
+		time_t mtime = r.read<int64_t>();
+		uint32_t tags_count = r.read<uint32_t>();
+		if (tags_count > r.remaining() / tag_size)
+			return false;
+		std::vector<MPD::Song::Tag> tags(tags_count);
+		for (auto &tag : tags)
+		{
+			uint32_t type = r.read<uint32_t>();
+			uint32_t value = r.read<uint32_t>();
+			if (type >= MPD_TAG_COUNT || value >= values.size())
+				return false;
+			tag.type = mpd_tag_type(type);
+			tag.value = values[value];
+		}
+		songs.push_back(MPD::Song(std::move(uri), std::move(tags), duration, mtime));
+	}
+	return true;
+}
+
+bool loadSnapshot(const Key &key, std::vector<MPD::Song> &songs)
+{
+	int fd = open(snapshotPath(key).c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	
+	bool result;
+	try
+	{
+		const char *begin = static_cast<const char *>(data);
+		Reader r(begin, begin+st.st_size);
+		result = parseSnapshot(r, key, songs);
+	}
+	catch (std::runtime_error &)
+	{
+		result = false;
+	}
+	munmap(data, st.st_size);
+	if (!result)
+		songs.clear();
+	return result;
+}
+
+std::string directoryOf(const std::string &uri)
+{
+	size_t slash = uri.rfind('/');
+	return slash != std::string::npos ? uri.substr(0, slash) : "";
+}
+
+// Adds modification times of files in directories [first, last) to the map.
+// Directories that aren't in the music storage (e.g. songs inside archives)
+// can't be listed and fail the whole command list, so failed batches are
+// split until only such directories are left out. Returns false if the
+// server doesn't support listing files (it's older than 0.19).
+bool addFilesMTimes(std::unordered_map<std::string, time_t> &mtimes,
+                    std::vector<std::string>::const_iterator first,
+                    std::vector<std::string>::const_iterator last)
+{
+	try
+	{
+		auto files = Mpd.GetFilesMTimes(std::vector<std::string>(first, last));
+		mtimes.insert(files.begin(), files.end());
+		return true;
+	}
+	catch (MPD::ServerError &e)
+	{
+		if (e.code() == MPD_SERVER_ERROR_UNKNOWN_CMD)
+			return false;
+	}
+	if (last-first == 1)
+		return true;
+	auto middle = first + (last-first)/2;
+	return addFilesMTimes(mtimes, first, middle)
+	    && addFilesMTimes(mtimes, middle, last);
+}
+
+std::unordered_map<std::string, time_t> filesMTimes(const std::set<std::string> &directory_set)
+{
+	std::vector<std::string> directories(directory_set.begin(), directory_set.end());
+	std::unordered_map<std::string, time_t> result;
+	for (size_t first = 0; first < directories.size(); first += MTimesBatchSize)
+	{
+		size_t last = std::min(first+MTimesBatchSize, directories.size());
+		if (!addFilesMTimes(result, directories.begin()+first, directories.begin()+last))
+			break;
+	}
+	return result;
+}
+
+// Patches the library using uris of all songs and songs modified since the
+// last update. Modified songs are found with modified-since search filter,
+// so it's only possible with libmpdclient 2.10 and newer. As it finds only
+// songs that became newer, modification times of other songs in directories
+// with new or newer ones are also compared with the ones of their files, so
+// that e.g. files restored from a backup along with a new one are noticed.
+// Checking all directories would mean listing the whole music storage on
+// each database update.
+bool resync(const Key &key, Library::Changes &changes)
+{
+#	if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+	std::unordered_map<std::string, MPD::Song> old_songs;
+	for (auto &s : library)
+	{
+		std::string uri = s.getURI();
+		old_songs.insert(std::make_pair(std::move(uri), std::move(s)));
+	}
+	library.clear();
+	
+	// uris are listed in database order, so they're used
+	// to put updated and unchanged songs in the right place.
+	std::vector<std::string> uris;
+	std::copy(
+		std::make_move_iterator(Mpd.GetURIsRecursive("/")),
+		std::make_move_iterator(MPD::StringIterator()),
+		std::back_inserter(uris)
+	);
+	
+	std::unordered_map<std::string, MPD::Song> new_songs;
+	Mpd.StartSearch(true);
+	Mpd.AddSearchModifiedSince(library_key.dbUpdate);
+	for (MPD::SongIterator s = Mpd.CommitSearchSongs(), end; s != end; ++s)
+		new_songs[s->getURI()] = std::move(*s);
+	
+	std::set<std::string> changed_directories;
+	for (const auto &uri : uris)
+		if (new_songs.find(uri) != new_songs.end() || old_songs.find(uri) == old_songs.end())
+			changed_directories.insert(directoryOf(uri));
+	
+	// new songs and songs whose files have different modification
+	// time are fetched from directories they're in.
+	auto mtimes = filesMTimes(changed_directories);
+	std::unordered_set<std::string> stale;
+	std::set<std::string> directories;
+	for (const auto &uri : uris)
+	{
+		if (new_songs.find(uri) != new_songs.end())
+			continue;
+		auto old_song = old_songs.find(uri);
+		auto mtime = mtimes.find(uri);
+		if (old_song == old_songs.end()
+		||  (mtime != mtimes.end() && mtime->second != old_song->second.getMTime()))
+		{
+			stale.insert(uri);
+			directories.insert(directoryOf(uri));
+		}
+	}
+	for (const auto &directory : directories)
+	{
+		for (MPD::ItemIterator item = Mpd.GetDirectory(directory), end; item != end; ++item)
+		{
+			if (item->type() == MPD::Item::Type::Song)
+			{
+				const auto &s = item->song();
+				if (stale.find(s.getURI()) != stale.end())
+					new_songs[s.getURI()] = s;
+			}
+		}
+	}
+	
+	library.reserve(uris.size());
+	for (const auto &uri : uris)
+	{
+		auto old_song = old_songs.find(uri);
+		auto new_song = new_songs.find(uri);
+		if (new_song != new_songs.end())
+		{
+			if (old_song != old_songs.end())
+			{
+				changes.removed.push_back(std::move(old_song->second));
+				old_songs.erase(old_song);
+			}
+			changes.added.push_back(new_song->second);
+			library.push_back(std::move(new_song->second));
+		}
+		else if (old_song != old_songs.end())
+		{
+			library.push_back(std::move(old_song->second));
+			old_songs.erase(old_song);
+		}
+	}
+	// songs that are not in the database anymore
+	for (auto &s : old_songs)
+		changes.removed.push_back(std::move(s.second));
+	
+	library_key = key;
+	saveSnapshot(library_key, library);
+	return true;
+#	else
+	(void)key;
+	(void)changes;
+	return false;
+#	endif // LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+}
+
+/**********************************************************************/
+
+// Trigrams are built out of case folded bytes. Folding is done for ASCII
+// letters only, so trigrams containing bytes of multibyte characters may
+// be used for lookups only if case of the string to find doesn't matter.
+bool foldByte(char c, uint32_t &result)
+{
+	unsigned char uc = c;
+	result = uc < 0x80 ? tolower(uc) : uc;
+	return uc < 0x80;
+}
+
+template <typename FunctionT>
+void forEachTrigram(boost::string_ref s, FunctionT f)
+{
+	uint32_t trigram = 0;
+	size_t ascii = 0;
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		uint32_t byte;
+		if (foldByte(s[i], byte))
+			++ascii;
+		else
+			ascii = 0;
+		trigram = ((trigram << 8) | byte) & 0xffffff;
+		if (i >= 2)
+			f(trigram, ascii >= 3);
+	}
+}
+
+void buildIndex()
+{
+	index_postings.clear();
+	for (size_t i = 0; i < library.size(); ++i)
+	{
+		for (auto tag = std::begin(IndexedTags); tag != std::end(IndexedTags); ++tag)
+		{
+			forEachTrigram((library[i].**tag)(0), [i](uint32_t trigram, bool ascii) {
+				if (!ascii)
+					return;
+				auto &postings = index_postings[trigram];
+				if (postings.empty() || postings.back() != i)
+					postings.push_back(i);
+			});
+		}
+	}
+	for (auto &postings : index_postings)
+		postings.second.shrink_to_fit();
+	index_built = true;
+}
+
+void addToSongsByTag(std::vector<MPD::Song>::const_iterator first,
+                     std::vector<MPD::Song>::const_iterator last)
+{
+	std::string tag;
+	for (; first != last; ++first)
+	{
+		const auto &s = *first;
+		auto album_key = std::make_pair(s.getAlbum(), s.getDate());
+		boost::string_ref view;
+		for (unsigned idx = 0; !(view = s.viewTag(songs_by_tag_type, idx)).empty(); ++idx)
+		{
+			tag.assign(view.begin(), view.end());
+			auto &tag_songs = songs_by_tag[tag];
+			auto &album_songs = tag_songs.albums[album_key];
+			tag_songs.mtime = std::max(tag_songs.mtime, s.getMTime());
+			album_songs.mtime = std::max(album_songs.mtime, s.getMTime());
+			album_songs.songs.push_back(s);
+		}
+	}
+}
+
+void removeFromSongsByTag(const std::vector<MPD::Song> &songs)
+{
+	std::string tag;
+	for (const auto &s : songs)
+	{
+		auto album_key = std::make_pair(s.getAlbum(), s.getDate());
+		boost::string_ref view;
+		for (unsigned idx = 0; !(view = s.viewTag(songs_by_tag_type, idx)).empty(); ++idx)
+		{
+			tag.assign(view.begin(), view.end());
+			auto tag_songs = songs_by_tag.find(tag);
+			if (tag_songs == songs_by_tag.end())
+				continue;
+			auto &albums = tag_songs->second.albums;
+			auto album_songs = albums.find(album_key);
+			if (album_songs == albums.end())
+				continue;
+			auto &album = album_songs->second;
+			auto it = std::find(album.songs.begin(), album.songs.end(), s);
+			if (it != album.songs.end())
+				album.songs.erase(it);
+			// modification times are the newest ones of what's left
+			if (album.songs.empty())
+				albums.erase(album_songs);
+			else
+			{
+				album.mtime = 0;
+				for (const auto &as : album.songs)
+					album.mtime = std::max(album.mtime, as.getMTime());
+			}
+			if (albums.empty())
+				songs_by_tag.erase(tag_songs);
+			else
+			{
+				tag_songs->second.mtime = 0;
+				for (const auto &a : albums)
+					tag_songs->second.mtime = std::max(tag_songs->second.mtime, a.second.mtime);
+			}
+		}
+	}
+}
+
+void buildSongsByTag(mpd_tag_type type)
+{
+	songs_by_tag.clear();
+	songs_by_tag_type = type;
+	addToSongsByTag(library.begin(), library.end());
+	songs_by_tag_built = true;
+}
+
+void clearIndexes()
+{
+	index_built = false;
+	index_postings.clear();
+	songs_by_tag_built = false;
+	songs_by_tag.clear();
+}
+
+// Adds songs received from the background to the library, returns true
+// if all of them were received. Errors of the worker are rethrown.
+bool receiveSongs()
+{
+	assert(background_load);
+	auto &load = *background_load;
+	// checked before taking the songs, so that none of them are left behind
+	bool finished = load.worker.is_ready();
+	std::vector<MPD::Song> songs;
+	{
+		std::lock_guard<std::mutex> lock(load.mutex);
+		songs.swap(load.received);
+	}
+	if (!songs.empty())
+	{
+		size_t first = library.size();
+		std::move(songs.begin(), songs.end(), std::back_inserter(library));
+		index_built = false;
+		index_postings.clear();
+		if (songs_by_tag_built)
+			addToSongsByTag(library.begin()+first, library.end());
+	}
+	if (finished)
+	{
+		auto finished_load = std::move(background_load);
+		try
+		{
+			finished_load->worker.get();
+		}
+		catch (...)
+		{
+			library.clear();
+			clearIndexes();
+			throw;
+		}
+		library_loaded = true;
+		library_key = std::move(finished_load->key);
+	}
+	return finished;
+}
+
+Key currentKey()
+{
+	Key key;
+	key.host = Mpd.GetHostname();
+	key.port = Mpd.GetPort();
+	key.dbUpdate = Mpd.getStatistics().dbUpdateTime();
+	return key;
+}
+
+}
+
+namespace Library {
+
+const std::vector<MPD::Song> &songs()
+{
+	if (background_load)
+	{
+		background_load->worker.wait();
+		receiveSongs();
+	}
+	Key key = currentKey();
+	if (library_loaded && key == library_key)
+		return library;
+	
+	library_loaded = false;
+	library.clear();
+	clearIndexes();
+	if (!loadSnapshot(key, library))
+	{
+		std::copy(
+			std::make_move_iterator(Mpd.GetDirectoryRecursive("/")),
+			std::make_move_iterator(MPD::SongIterator()),
+			std::back_inserter(library)
+		);
+		saveSnapshot(key, library);
+	}
+	library_loaded = true;
+	library_key = std::move(key);
+	return library;
+}
+
+bool loadInBackground()
+{
+	if (!background_load)
+	{
+		Key key = currentKey();
+		if (library_loaded && key == library_key)
+			return false;
+		library_loaded = false;
+		library.clear();
+		clearIndexes();
+		
+		auto load = std::make_shared<BackgroundLoad>();
+		load->key = std::move(key);
+		// main connection can't be used outside of the main thread
+		std::string host = Mpd.GetHostname(), password = Mpd.GetPassword();
+		int port = Mpd.GetPort(), timeout = Mpd.GetTimeout();
+		load->worker = boost::async(boost::launch::async, [load, host, port, timeout, password] {
+			std::vector<MPD::Song> songs;
+			if (loadSnapshot(load->key, songs))
+			{
+				std::lock_guard<std::mutex> lock(load->mutex);
+				load->received = std::move(songs);
+				return;
+			}
+			MPD::Connection mpd;
+			mpd.SetHostname(host);
+			mpd.SetPort(port);
+			mpd.SetTimeout(timeout);
+			mpd.SetPassword(password);
+			mpd.Connect();
+			size_t handed_over = 0;
+			auto hand_over = [&load, &songs, &handed_over] {
+				std::lock_guard<std::mutex> lock(load->mutex);
+				load->received.insert(load->received.end(), songs.begin()+handed_over, songs.end());
+				handed_over = songs.size();
+			};
+			for (MPD::SongIterator s = mpd.GetDirectoryRecursive("/"), end; s != end; ++s)
+			{
+				songs.push_back(std::move(*s));
+				if (songs.size() - handed_over == BackgroundBatchSize)
+					hand_over();
+			}
+			hand_over();
+			saveSnapshot(load->key, songs);
+		});
+		background_load = std::move(load);
+	}
+	return !receiveSongs();
+}
+
+size_t loadedSongsCount()
+{
+	return library.size();
+}
+
+Changes update()
+{
+	Changes changes;
+	if (!library_loaded)
+	{
+		changes.reloaded = true;
+		return changes;
+	}
+	Key key = currentKey();
+	if (key == library_key)
+		return changes;
+	library_loaded = false;
+	// positions of songs change, so trigram index needs to be built anew
+	index_built = false;
+	index_postings.clear();
+	if (key.host == library_key.host
+	&&  key.port == library_key.port
+	&&  resync(key, changes))
+	{
+		library_loaded = true;
+		if (songs_by_tag_built)
+		{
+			removeFromSongsByTag(changes.removed);
+			addToSongsByTag(changes.added.begin(), changes.added.end());
+		}
+	}
+	else
+	{
+		library.clear();
+		clearIndexes();
+		changes.removed.clear();
+		changes.added.clear();
+		changes.reloaded = true;
+	}
+	return changes;
+}
+
+std::vector<size_t> candidates(const std::vector<std::string> &strings)
+{
+	const auto &songs = Library::songs();
+	if (!index_built)
+		buildIndex();
+	
+	std::vector<const std::vector<uint32_t> *> lists;
+	for (const auto &s : strings)
+	{
+		bool found = true;
+		forEachTrigram(s, [&lists, &found](uint32_t trigram, bool ascii) {
+			if (!ascii || !found)
+				return;
+			auto it = index_postings.find(trigram);
+			if (it != index_postings.end())
+				lists.push_back(&it->second);
+			else
+				found = false;
+		});
+		if (!found)
+			return std::vector<size_t>();
+	}
+	
+	std::vector<size_t> result;
+	if (lists.empty())
+	{
+		result.resize(songs.size());
+		for (size_t i = 0; i < result.size(); ++i)
+			result[i] = i;
+		return result;
+	}
+	// start with the shortest list to keep intersections small
+	std::sort(lists.begin(), lists.end(),
+		[](const std::vector<uint32_t> *a, const std::vector<uint32_t> *b) {
+			return a->size() < b->size();
+	});
+	result.assign(lists[0]->begin(), lists[0]->end());
+	std::vector<size_t> intersection;
+	for (auto list = lists.begin()+1; list != lists.end() && !result.empty(); ++list)
+	{
+		intersection.clear();
+		std::set_intersection(
+			result.begin(), result.end(),
+			(*list)->begin(), (*list)->end(),
+			std::back_inserter(intersection)
+		);
+		result.swap(intersection);
+	}
+	return result;
+}
+
+const SongsByTag &songsByTag(mpd_tag_type tag)
+{
+	if (!songs_by_tag_built || songs_by_tag_type != tag)
+	{
+		if (!background_load)
+			Library::songs();
+		buildSongsByTag(tag);
+	}
+	return songs_by_tag;
+}
+
+}
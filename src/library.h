@@ -0,0 +1,95 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef NCMPCPP_LIBRARY_H
+#define NCMPCPP_LIBRARY_H
+
+#include <map>
+#include <vector>
+#include "song.h"
+
+namespace Library {
+
+struct AlbumSongs
+{
+	AlbumSongs() : mtime(0) { }
+	
+	time_t mtime;
+	std::vector<MPD::Song> songs;
+};
+
+struct TagSongs
+{
+	TagSongs() : mtime(0) { }
+	
+	time_t mtime;
+	// keyed by album and date
+	std::map<std::pair<std::string, std::string>, AlbumSongs> albums;
+};
+
+typedef std::map<std::string, TagSongs> SongsByTag;
+
+// Returns all songs in the database. They are kept both in memory and in
+// a snapshot stored in ncmpcpp directory, keyed by the host and the time
+// of the last database update, so that they have to be fetched from MPD
+// only if the database was changed since they were seen the last time.
+const std::vector<MPD::Song> &songs();
+
+// Starts fetching songs() in the background if they are not up to date.
+// Songs that arrived since the last call are added to the library, so that
+// songsByTag() can show them right away, while songs() waits until all of
+// them are fetched. Returns true while songs are still being fetched.
+bool loadInBackground();
+
+// Number of songs in memory, including ones that arrived from the
+// background so far while the rest of them is still being fetched.
+size_t loadedSongsCount();
+
+// Songs that were removed from and added to the library by update(),
+// modified ones are among both. If the library couldn't be updated in
+// place and will be fetched anew, reloaded is set instead.
+struct Changes
+{
+	Changes() : reloaded(false) { }
+	
+	bool reloaded;
+	std::vector<MPD::Song> removed;
+	std::vector<MPD::Song> added;
+};
+
+// Brings in-memory copy of the database up to date after it was updated.
+// Only songs that were added or modified since the last update are fetched
+// and songsByTag() is patched with them instead of being grouped again.
+Changes update();
+
+// Narrows down songs() to the ones that may contain each of given strings
+// in one of their tags, ignoring case. Uses trigram index that is built on
+// the first use. Returned positions are sorted, matches need to be verified.
+std::vector<size_t> candidates(const std::vector<std::string> &strings);
+
+// Groups songs() by each value of the tag, then by their album and date.
+// Songs are grouped in a single pass when the tree is needed for the first
+// time after the library changed, later lookups don't query MPD at all.
+// While songs are fetched in the background, only received ones are grouped.
+const SongsByTag &songsByTag(mpd_tag_type tag);
+
+}
+
+#endif // NCMPCPP_LIBRARY_H
@@ -24,11 +24,13 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <set>
 
 #include "charset.h"
 #include "display.h"
 #include "helpers.h"
 #include "global.h"
+#include "library.h"
 #include "mpdpp.h"
 #include "playlist.h"
 #include "media_library.h"
@@ -57,16 +59,57 @@ size_t itsRightColStartX;
 
 typedef MediaLibrary::AlbumEntry AlbumEntry;
 
-MPD::SongIterator getSongsFromAlbum(const AlbumEntry &album)
+std::vector<MPD::Song> getSongsFromTag(const std::string &tag)
 {
-	Mpd.StartSearch(true);
-	Mpd.AddSearch(Config.media_lib_primary_tag, album.entry().tag());
-	if (!album.isAllTracksEntry())
+	std::vector<MPD::Song> result;
+	const auto &songs_by_tag = Library::songsByTag(Config.media_lib_primary_tag);
+	auto it = songs_by_tag.find(tag);
+	if (it != songs_by_tag.end())
+		for (const auto &album : it->second.albums)
+			result.insert(result.end(), album.second.songs.begin(), album.second.songs.end());
+	return result;
+}
+
+std::vector<MPD::Song> getSongsFromAlbum(const AlbumEntry &album)
+{
+	if (album.isAllTracksEntry())
+		return getSongsFromTag(album.entry().tag());
+	const auto &songs_by_tag = Library::songsByTag(Config.media_lib_primary_tag);
+	auto tag = songs_by_tag.find(album.entry().tag());
+	if (tag != songs_by_tag.end())
 	{
-		Mpd.AddSearch(MPD_TAG_ALBUM, album.entry().album());
-		Mpd.AddSearch(MPD_TAG_DATE, album.entry().date());
+		auto it = tag->second.albums.find(
+			std::make_pair(album.entry().album(), album.entry().date())
+		);
+		if (it != tag->second.albums.end())
+			return it->second.songs;
+	}
+	return std::vector<MPD::Song>();
+}
+
+typedef std::tuple<bool, std::string, std::string, std::string> AlbumKey;
+
+AlbumKey albumKey(const AlbumEntry &ae)
+{
+	return AlbumKey(ae.isAllTracksEntry(), ae.entry().tag(), ae.entry().album(), ae.entry().date());
+}
+
+AlbumKey currentAlbum(NC::Menu<AlbumEntry> &albums)
+{
+	return albums.empty() ? AlbumKey() : albumKey(albums.current()->value());
+}
+
+// highlights the album that was highlighted before the column was rebuilt
+void highlightAlbum(NC::Menu<AlbumEntry> &albums, const AlbumKey &key)
+{
+	for (auto it = albums.begin(); it != albums.end(); ++it)
+	{
+		if (!it->isSeparator() && albumKey(it->value()) == key)
+		{
+			albums.highlight(it-albums.begin());
+			break;
+		}
 	}
-	return Mpd.CommitSearchSongs();
 }
 
 std::string AlbumToString(const AlbumEntry &ae);
@@ -79,7 +122,7 @@ bool SongEntryMatcher(const boost::regex &rx, const MPD::Song &s);
 struct SortSongs {
 	typedef NC::Menu<MPD::Song>::Item SongItem;
 	
-	static const std::array<MPD::Song::GetFunction, 3> GetFuns;
+	static const std::array<MPD::Song::ViewFunction, 3> ViewFuns;
 	
 	LocaleStringComparison m_cmp;
 	std::ptrdiff_t m_offset;
@@ -88,24 +131,22 @@ public:
 	SortSongs(bool disc_only)
 	: m_cmp(std::locale(), Config.ignore_leading_the), m_offset(disc_only ? 2 : 0) { }
 	
-	bool operator()(const SongItem &a, const SongItem &b) {
-		return (*this)(a.value(), b.value());
+	std::string key(const SongItem &s) const {
+		return key(s.value());
 	}
-	bool operator()(const MPD::Song &a, const MPD::Song &b) {
-		for (auto get = GetFuns.begin()+m_offset; get != GetFuns.end(); ++get) {
-			int ret = m_cmp(a.getTags(*get),
-			                b.getTags(*get));
-			if (ret != 0)
-				return ret < 0;
-		}
-		return a.getTrack() < b.getTrack();
+	std::string key(const MPD::Song &s) const {
+		std::string result, buffer;
+		for (auto view = ViewFuns.begin()+m_offset; view != ViewFuns.end(); ++view)
+			m_cmp.appendKey(result, s.viewTags(*view, buffer));
+		result += s.getTrack();
+		return result;
 	}
 };
 
-const std::array<MPD::Song::GetFunction, 3> SortSongs::GetFuns = {{
-	&MPD::Song::getDate,
-	&MPD::Song::getAlbum,
-	&MPD::Song::getDisc
+const std::array<MPD::Song::ViewFunction, 3> SortSongs::ViewFuns = {{
+	&MPD::Song::viewDate,
+	&MPD::Song::viewAlbum,
+	&MPD::Song::viewDisc
 }};
 
 class SortAlbumEntries {
@@ -116,24 +157,21 @@ class SortAlbumEntries {
 public:
 	SortAlbumEntries() : m_cmp(std::locale(), Config.ignore_leading_the) { }
 	
-	bool operator()(const AlbumEntry &a, const AlbumEntry &b) const {
-		return (*this)(a.entry(), b.entry());
+	std::string key(const AlbumEntry &a) const {
+		return key(a.entry());
 	}
 	
-	bool operator()(const Album &a, const Album &b) const {
+	std::string key(const Album &a) const {
+		std::string result;
 		if (Config.media_library_sort_by_mtime)
-			return a.mtime() > b.mtime();
+			appendNumberKey(result, -int64_t(a.mtime()));
 		else
 		{
-			int result;
-			result = m_cmp(a.tag(), b.tag());
-			if (result != 0)
-				return result < 0;
-			result = m_cmp(a.date(), b.date());
-			if (result != 0)
-				return result < 0;
-			return m_cmp(a.album(), b.album()) < 0;
+			m_cmp.appendKey(result, a.tag());
+			m_cmp.appendKey(result, a.date());
+			m_cmp.appendKey(result, a.album());
 		}
+		return result;
 	}
 };
 
@@ -145,22 +183,30 @@ class SortPrimaryTags {
 public:
 	SortPrimaryTags() : m_cmp(std::locale(), Config.ignore_leading_the) { }
 	
-	bool operator()(const PrimaryTag &a, const PrimaryTag &b) const {
+	std::string key(const PrimaryTag &a) const {
+		std::string result;
 		if (Config.media_library_sort_by_mtime)
-			return a.mtime() > b.mtime();
+			appendNumberKey(result, -int64_t(a.mtime()));
 		else
-			return m_cmp(a.tag(), b.tag()) < 0;
+			m_cmp.appendKey(result, a.tag());
+		return result;
 	}
 };
 
 }
 
 MediaLibrary::MediaLibrary()
-: m_timer(boost::posix_time::from_time_t(0))
+: m_loaded_songs_time(boost::posix_time::from_time_t(0))
+, m_timer(boost::posix_time::from_time_t(0))
 , m_window_timeout(Config.data_fetching_delay ? 250 : 500)
 , m_fetching_delay(boost::posix_time::milliseconds(Config.data_fetching_delay ? 250 : -1))
 {
 	hasTwoColumns = 0;
+	m_tags_update_request = false;
+	m_albums_update_request = false;
+	m_songs_update_request = false;
+	m_library_loading = false;
+	m_loaded_songs = 0;
 	itsLeftColWidth = COLS/3-1;
 	itsMiddleColWidth = COLS/3;
 	itsMiddleColStartX = itsLeftColWidth+1;
@@ -253,7 +299,7 @@ void MediaLibrary::refresh()
 void MediaLibrary::switchTo()
 {
 	SwitchTo::execute(this);
-	markSongsInPlaylist(songsProxyList());
+	markSongsInPlaylist();
 	drawHeader();
 	refresh();
 }
@@ -265,44 +311,67 @@ std::wstring MediaLibrary::title()
 
 void MediaLibrary::update()
 {
+	// while songs are fetched in the background, tags and albums
+	// are refreshed with the ones that arrived so far.
+	if (m_library_loading
+	||  (hasTwoColumns && (Albums.empty() || m_albums_update_request))
+	||  (!hasTwoColumns && (Tags.empty() || m_tags_update_request)))
+	{
+		bool was_loading = m_library_loading;
+		m_library_loading = Library::loadInBackground();
+		if (m_library_loading)
+		{
+			Statusbar::print("Loading library...");
+			// columns are built as a whole, so they're rebuilt only after
+			// the number of songs grew by half or a second passed, not on
+			// every poll, which would keep re-sorting them and flickering.
+			size_t loaded = Library::loadedSongsCount();
+			if (loaded > m_loaded_songs
+			&&  (loaded >= m_loaded_songs + m_loaded_songs/2
+			||   Global::Timer - m_loaded_songs_time >= boost::posix_time::seconds(1)))
+			{
+				m_loaded_songs = loaded;
+				m_loaded_songs_time = Global::Timer;
+				m_tags_update_request = m_albums_update_request = true;
+			}
+		}
+		else if (was_loading)
+		{
+			m_loaded_songs = 0;
+			// songs are refreshed only once all of them are there, so
+			// that selected ones are not reordered under the cursor.
+			m_tags_update_request = m_albums_update_request = m_songs_update_request = true;
+		}
+	}
+	
 	if (hasTwoColumns)
 	{
 		if (Albums.empty() || m_albums_update_request)
 		{
 			m_albums_update_request = false;
-			std::map<std::tuple<std::string, std::string, std::string>, time_t> albums;
-			for (MPD::SongIterator s = Mpd.GetDirectoryRecursive("/"), end; s != end; ++s)
+			auto current = currentAlbum(Albums);
+			size_t idx = 0;
+			for (const auto &tag : Library::songsByTag(Config.media_lib_primary_tag))
 			{
-				std::string tag;
-				unsigned idx = 0;
-				while (!(tag = s->get(Config.media_lib_primary_tag, idx++)).empty())
+				for (const auto &album : tag.second.albums)
 				{
-					auto key = std::make_tuple(std::move(tag), s->getAlbum(), s->getDate());
-					auto it = albums.find(key);
-					if (it == albums.end())
-						albums[std::move(key)] = s->getMTime();
+					auto entry = AlbumEntry(Album(
+						tag.first,
+						album.first.first,
+						album.first.second,
+						album.second.mtime)
+					);
+					if (idx < Albums.size())
+						Albums[idx].value() = std::move(entry);
 					else
-						it->second = s->getMTime();
+						Albums.addItem(std::move(entry));
+					++idx;
 				}
 			}
-			size_t idx = 0;
-			for (const auto &album : albums)
-			{
-				auto entry = AlbumEntry(Album(
-					std::move(std::get<0>(album.first)),
-					std::move(std::get<1>(album.first)),
-					std::move(std::get<2>(album.first)),
-					album.second)
-				);
-				if (idx < Albums.size())
-					Albums[idx].value() = std::move(entry);
-				else
-					Albums.addItem(std::move(entry));
-				++idx;
-			}
 			if (idx < Albums.size())
 				Albums.resizeList(idx);
-			std::sort(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+			sortByKeys(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+			highlightAlbum(Albums, current);
 			Albums.refresh();
 		}
 	}
@@ -311,33 +380,11 @@ void MediaLibrary::update()
 		if (Tags.empty() || m_tags_update_request)
 		{
 			m_tags_update_request = false;
-			std::map<std::string, time_t> tags;
-			if (Config.media_library_sort_by_mtime)
-			{
-				for (MPD::SongIterator s = Mpd.GetDirectoryRecursive("/"), end; s != end; ++s)
-				{
-					std::string tag;
-					unsigned idx = 0;
-					while (!(tag = s->get(Config.media_lib_primary_tag, idx++)).empty())
-					{
-						auto it = tags.find(tag);
-						if (it == tags.end())
-							tags[std::move(tag)] = s->getMTime();
-						else
-							it->second = std::max(it->second, s->getMTime());
-					}
-				}
-			}
-			else
-			{
-				MPD::StringIterator tag = Mpd.GetList(Config.media_lib_primary_tag), end;
-				for (; tag != end; ++tag)
-					tags[std::move(*tag)] = 0;
-			}
+			std::string current = Tags.empty() ? "" : Tags.current()->value().tag();
 			size_t idx = 0;
-			for (const auto &tag : tags)
+			for (const auto &tag : Library::songsByTag(Config.media_lib_primary_tag))
 			{
-				auto ptag = PrimaryTag(std::move(tag.first), tag.second);
+				auto ptag = PrimaryTag(tag.first, tag.second.mtime);
 				if (idx < Tags.size())
 					Tags[idx].value() = std::move(ptag);
 				else
@@ -346,7 +393,12 @@ void MediaLibrary::update()
 			}
 			if (idx < Tags.size())
 				Tags.resizeList(idx);
-			std::sort(Tags.beginV(), Tags.endV(), SortPrimaryTags());
+			sortByKeys(Tags.beginV(), Tags.endV(), SortPrimaryTags());
+			auto it = std::find_if(Tags.beginV(), Tags.endV(), [&current](const PrimaryTag &tag) {
+				return tag.tag() == current;
+			});
+			if (it != Tags.endV())
+				Tags.highlight(it-Tags.beginV());
 			Tags.refresh();
 		}
 		
@@ -355,45 +407,40 @@ void MediaLibrary::update()
 		)
 		{
 			m_albums_update_request = false;
+			auto current = currentAlbum(Albums);
 			auto &primary_tag = Tags.current()->value().tag();
-			Mpd.StartSearch(true);
-			Mpd.AddSearch(Config.media_lib_primary_tag, primary_tag);
-			std::map<std::tuple<std::string, std::string>, time_t> albums;
-			for (MPD::SongIterator s = Mpd.CommitSearchSongs(), end; s != end; ++s)
-			{
-				auto key = std::make_tuple(s->getAlbum(), s->getDate());
-				auto it = albums.find(key);
-				if (it == albums.end())
-					albums[std::move(key)] = s->getMTime();
-				else
-					it->second = std::max(it->second, s->getMTime());
-			};
+			const auto &songs_by_tag = Library::songsByTag(Config.media_lib_primary_tag);
+			auto tag = songs_by_tag.find(primary_tag);
 			size_t idx = 0;
-			for (const auto &album : albums)
+			if (tag != songs_by_tag.end())
 			{
-				auto entry = AlbumEntry(Album(
-					primary_tag,
-					std::move(std::get<0>(album.first)),
-					std::move(std::get<1>(album.first)),
-					album.second)
-				);
-				if (idx < Albums.size())
+				for (const auto &album : tag->second.albums)
 				{
-					Albums[idx].value() = std::move(entry);
-					Albums[idx].setSeparator(false);
+					auto entry = AlbumEntry(Album(
+						primary_tag,
+						album.first.first,
+						album.first.second,
+						album.second.mtime)
+					);
+					if (idx < Albums.size())
+					{
+						Albums[idx].value() = std::move(entry);
+						Albums[idx].setSeparator(false);
+					}
+					else
+						Albums.addItem(std::move(entry));
+					++idx;
 				}
-				else
-					Albums.addItem(std::move(entry));
-				++idx;
 			}
 			if (idx < Albums.size())
 				Albums.resizeList(idx);
-			std::sort(Albums.beginV(), Albums.endV(), SortAlbumEntries());
-			if (albums.size() > 1)
+			sortByKeys(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+			if (idx > 1)
 			{
 				Albums.addSeparator();
 				Albums.addItem(AlbumEntry::mkAllTracksEntry(primary_tag));
 			}
+			highlightAlbum(Albums, current);
 			Albums.refresh();
 		}
 	}
@@ -403,36 +450,31 @@ void MediaLibrary::update()
 	)
 	{
 		m_songs_update_request = false;
+		m_playlist_marker.invalidate();
 		auto &album = Albums.current()->value();
-		Mpd.StartSearch(true);
-		Mpd.AddSearch(Config.media_lib_primary_tag, album.entry().tag());
-		if (!album.isAllTracksEntry())
-		{
-			Mpd.AddSearch(MPD_TAG_ALBUM, album.entry().album());
-			Mpd.AddSearch(MPD_TAG_DATE, album.entry().date());
-		}
 		size_t idx = 0;
-		for (MPD::SongIterator s = Mpd.CommitSearchSongs(), end; s != end; ++s, ++idx)
+		for (auto &s : getSongsFromAlbum(album))
 		{
-			bool is_playlist = myPlaylist->checkForSong(*s);
+			bool is_playlist = myPlaylist->checkForSong(s);
 			if (idx < Songs.size())
 			{
-				Songs[idx].value() = std::move(*s);
+				Songs[idx].value() = std::move(s);
 				Songs[idx].setBold(is_playlist);
 			}
 			else
-				Songs.addItem(std::move(*s), is_playlist);
-		};
+				Songs.addItem(std::move(s), is_playlist);
+			++idx;
+		}
 		if (idx < Songs.size())
 			Songs.resizeList(idx);
-		std::sort(Songs.begin(), Songs.end(), SortSongs(!album.isAllTracksEntry()));
+		sortByKeys(Songs.begin(), Songs.end(), SortSongs(!album.isAllTracksEntry()));
 		Songs.refresh();
 	}
 }
 
 int MediaLibrary::windowTimeout()
 {
-	if (Albums.empty() || Songs.empty())
+	if (m_library_loading || Albums.empty() || Songs.empty())
 		return m_window_timeout;
 	else
 		return Screen<WindowType>::windowTimeout();
@@ -594,10 +636,15 @@ void MediaLibrary::setSearchConstraint(const std::string &constraint)
 	}
 	else if (isActiveWindow(Songs))
 	{
-		m_songs_search_predicate = RegexFilter<MPD::Song>(
-			boost::regex(constraint, Config.regex_type),
-			SongEntryMatcher
-		);
+		if (Config.fuzzy_find)
+			m_songs_search_predicate = RegexFilter<MPD::Song>(
+				FuzzyPattern(constraint), fuzzySongScore
+			);
+		else
+			m_songs_search_predicate = RegexFilter<MPD::Song>(
+				boost::regex(constraint, Config.regex_type),
+				SongEntryMatcher
+			);
 	}
 }
 
@@ -660,13 +707,8 @@ std::vector<MPD::Song> MediaLibrary::getSelectedSongs()
 	if (isActiveWindow(Tags))
 	{
 		auto tag_handler = [&result](const std::string &tag) {
-			Mpd.StartSearch(true);
-			Mpd.AddSearch(Config.media_lib_primary_tag, tag);
-			std::copy(
-				std::make_move_iterator(Mpd.CommitSearchSongs()),
-				std::make_move_iterator(MPD::SongIterator()),
-				std::back_inserter(result)
-			);
+			auto songs = getSongsFromTag(tag);
+			std::move(songs.begin(), songs.end(), std::back_inserter(result));
 		};
 		bool any_selected = false;
 		for (auto &e : Tags)
@@ -689,34 +731,19 @@ std::vector<MPD::Song> MediaLibrary::getSelectedSongs()
 			if (it->isSelected())
 			{
 				any_selected = true;
-				auto &sc = it->value();
-				Mpd.StartSearch(true);
-				if (hasTwoColumns)
-					Mpd.AddSearch(Config.media_lib_primary_tag, sc.entry().tag());
-				else
-					Mpd.AddSearch(Config.media_lib_primary_tag,
-					              Tags.current()->value().tag());
-					Mpd.AddSearch(MPD_TAG_ALBUM, sc.entry().album());
-				Mpd.AddSearch(MPD_TAG_DATE, sc.entry().date());
+				auto songs = getSongsFromAlbum(it->value());
 				size_t begin = result.size();
-				std::copy(
-					std::make_move_iterator(Mpd.CommitSearchSongs()),
-					std::make_move_iterator(MPD::SongIterator()),
-					std::back_inserter(result)
-				);
-				std::sort(result.begin()+begin, result.end(), SortSongs(false));
+				std::move(songs.begin(), songs.end(), std::back_inserter(result));
+				sortByKeys(result.begin()+begin, result.end(), SortSongs(false));
 			}
 		}
 		// if no item is selected, add songs from right column
 		if (!any_selected && !Albums.empty())
 		{
+			auto songs = getSongsFromAlbum(Albums.current()->value());
 			size_t begin = result.size();
-			std::copy(
-				std::make_move_iterator(getSongsFromAlbum(Albums.current()->value().entry())),
-				std::make_move_iterator(MPD::SongIterator()),
-				std::back_inserter(result)
-			);
-			std::sort(result.begin()+begin, result.end(), SortSongs(false));
+			std::move(songs.begin(), songs.end(), std::back_inserter(result));
+			sortByKeys(result.begin()+begin, result.end(), SortSongs(false));
 		}
 	}
 	else if (isActiveWindow(Songs))
@@ -847,6 +874,54 @@ ProxySongList MediaLibrary::songsProxyList()
 	});
 }
 
+void MediaLibrary::markSongsInPlaylist()
+{
+	m_playlist_marker.mark(songsProxyList());
+}
+
+void MediaLibrary::libraryUpdated(const Library::Changes &changes)
+{
+	if (changes.reloaded)
+	{
+		requestTagsUpdate();
+		requestAlbumsUpdate();
+		requestSongsUpdate();
+		return;
+	}
+	std::set<std::string> tags;
+	std::set<AlbumKey> albums;
+	auto add_song = [&tags, &albums](const MPD::Song &s) {
+		std::string tag;
+		for (unsigned idx = 0; !(tag = s.get(Config.media_lib_primary_tag, idx)).empty(); ++idx)
+		{
+			albums.insert(AlbumKey(false, tag, s.getAlbum(), s.getDate()));
+			tags.insert(std::move(tag));
+		}
+	};
+	std::for_each(changes.removed.begin(), changes.removed.end(), add_song);
+	std::for_each(changes.added.begin(), changes.added.end(), add_song);
+	// songs without primary tag are not in the library
+	if (tags.empty())
+		return;
+	
+	if (hasTwoColumns)
+		requestAlbumsUpdate();
+	else
+	{
+		requestTagsUpdate();
+		if (!Tags.empty() && tags.find(Tags.current()->value().tag()) != tags.end())
+			requestAlbumsUpdate();
+	}
+	if (!Albums.empty())
+	{
+		auto &album = Albums.current()->value();
+		if (album.isAllTracksEntry()
+		?   tags.find(album.entry().tag()) != tags.end()
+		:   albums.find(albumKey(album)) != albums.end())
+			requestSongsUpdate();
+	}
+}
+
 void MediaLibrary::toggleSortMode()
 {
 	Config.media_library_sort_by_mtime = !Config.media_library_sort_by_mtime;
@@ -854,7 +929,7 @@ void MediaLibrary::toggleSortMode()
 		Config.media_library_sort_by_mtime ? "modification time" : "name");
 	if (hasTwoColumns)
 	{
-		std::sort(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+		sortByKeys(Albums.beginV(), Albums.endV(), SortAlbumEntries());
 		Albums.refresh();
 		Songs.clear();
 		if (Config.titles_visibility)
@@ -870,7 +945,7 @@ void MediaLibrary::toggleSortMode()
 		// if we already have modification times, just resort. otherwise refetch the list.
 		if (!Tags.empty() && Tags[0].value().mtime() > 0)
 		{
-			std::sort(Tags.beginV(), Tags.endV(), SortPrimaryTags());
+			sortByKeys(Tags.beginV(), Tags.endV(), SortPrimaryTags());
 			Tags.refresh();
 		}
 		else
@@ -974,12 +1049,7 @@ void MediaLibrary::AddToPlaylist(bool add_n_play)
 		if ((!Tags.empty() && isActiveWindow(Tags))
 		||  (isActiveWindow(Albums) && Albums.current()->value().isAllTracksEntry()))
 		{
-			Mpd.StartSearch(true);
-			Mpd.AddSearch(Config.media_lib_primary_tag, Tags.current()->value().tag());
-			std::vector<MPD::Song> list(
-				std::make_move_iterator(Mpd.CommitSearchSongs()),
-				std::make_move_iterator(MPD::SongIterator())
-			);
+			auto list = getSongsFromTag(Tags.current()->value().tag());
 			bool success = addSongsToPlaylist(list.begin(), list.end(), add_n_play, -1);
 			std::string tag_type = boost::locale::to_lower(
 				tagTypeToString(Config.media_lib_primary_tag));
@@ -989,10 +1059,7 @@ void MediaLibrary::AddToPlaylist(bool add_n_play)
 		}
 		else if (isActiveWindow(Albums))
 		{
-			std::vector<MPD::Song> list(
-				std::make_move_iterator(getSongsFromAlbum(Albums.current()->value())),
-				std::make_move_iterator(MPD::SongIterator())
-			);
+			auto list = getSongsFromAlbum(Albums.current()->value());
 			bool success = addSongsToPlaylist(list.begin(), list.end(), add_n_play, -1);
 			Statusbar::printf("Songs from album \"%1%\" added%2%",
 				Albums.current()->value().entry().album(), withErrors(success)
@@ -24,6 +24,7 @@
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "interfaces.h"
+#include "library.h"
 #include "regex_filter.h"
 #include "screen.h"
 
@@ -74,12 +75,16 @@ struct MediaLibrary: Screen<NC::Window *>, HasColumns, HasSongs, Searchable, Tab
 	int Columns();
 	void LocateSong(const MPD::Song &);
 	ProxySongList songsProxyList();
+	void markSongsInPlaylist();
 	void toggleSortMode();
 	
 	void requestTagsUpdate() { m_tags_update_request = true; }
 	void requestAlbumsUpdate() { m_albums_update_request = true; }
 	void requestSongsUpdate() { m_songs_update_request = true; }
 	
+	// requests updates of columns that contain changed songs
+	void libraryUpdated(const Library::Changes &changes);
+	
 	struct PrimaryTag
 	{
 		PrimaryTag() : m_mtime(0) { }
@@ -144,6 +149,11 @@ private:
 	bool m_tags_update_request;
 	bool m_albums_update_request;
 	bool m_songs_update_request;
+	bool m_library_loading;
+	
+	// number of songs the columns were built from while loading
+	size_t m_loaded_songs;
+	boost::posix_time::ptime m_loaded_songs_time;
 
 	boost::posix_time::ptime m_timer;
 
@@ -153,6 +163,8 @@ private:
 	RegexFilter<PrimaryTag> m_tags_search_predicate;
 	RegexItemFilter<AlbumEntry> m_albums_search_predicate;
 	RegexFilter<MPD::Song> m_songs_search_predicate;
+	
+	SongsInPlaylistMarker m_playlist_marker;
 
 };
 
@@ -23,6 +23,7 @@
 
 #include <boost/iterator/indirect_iterator.hpp>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <memory>
@@ -37,8 +38,6 @@ namespace NC {
 /// holding any std::vector compatible values.
 template <typename ItemT> class Menu : public Window
 {
-	struct ItemProxy;
-
 public:
 	struct Item
 	{
@@ -46,10 +45,10 @@ public:
 		
 		friend class Menu<ItemT>;
 		
-		Item()
-		: m_is_bold(false), m_is_selected(false), m_is_inactive(false), m_is_separator(false) { }
+		Item() : m_flags(0) { }
 		Item(ItemT value_, bool is_bold, bool is_inactive)
-		: m_value(value_), m_is_bold(is_bold), m_is_selected(false), m_is_inactive(is_inactive), m_is_separator(false) { }
+		: m_value(std::move(value_))
+		, m_flags((is_bold ? Bold : 0) | (is_inactive ? Inactive : 0)) { }
 		
 		ItemT &value() { return m_value; }
 		const ItemT &value() const { return m_value; }
@@ -57,41 +56,40 @@ public:
 		ItemT &operator*() { return m_value; }
 		const ItemT &operator*() const { return m_value; }
 
-		void setBold(bool is_bold) { m_is_bold = is_bold; }
-		void setSelected(bool is_selected) { m_is_selected = is_selected; }
-		void setInactive(bool is_inactive) { m_is_inactive = is_inactive; }
-		void setSeparator(bool is_separator) { m_is_separator = is_separator; }
+		void setBold(bool is_bold) { setFlag(Bold, is_bold); }
+		void setSelected(bool is_selected) { setFlag(Selected, is_selected); }
+		void setInactive(bool is_inactive) { setFlag(Inactive, is_inactive); }
+		void setSeparator(bool is_separator) { setFlag(Separator, is_separator); }
 		
-		bool isBold() const { return m_is_bold; }
-		bool isSelected() const { return m_is_selected; }
-		bool isInactive() const { return m_is_inactive; }
-		bool isSeparator() const { return m_is_separator; }
+		bool isBold() const { return m_flags & Bold; }
+		bool isSelected() const { return m_flags & Selected; }
+		bool isInactive() const { return m_flags & Inactive; }
+		bool isSeparator() const { return m_flags & Separator; }
 		
 	private:
+		enum Flag { Bold = 1, Selected = 2, Inactive = 4, Separator = 8 };
+		
 		static Item mkSeparator()
 		{
 			Item item;
-			item.m_is_separator = true;
+			item.m_flags = Separator;
 			return item;
 		}
 		
+		void setFlag(Flag flag, bool state)
+		{
+			if (state)
+				m_flags |= flag;
+			else
+				m_flags &= ~flag;
+		}
+		
 		ItemT m_value;
-		bool m_is_bold;
-		bool m_is_selected;
-		bool m_is_inactive;
-		bool m_is_separator;
+		uint8_t m_flags;
 	};
 	
-	typedef boost::indirect_iterator<
-		typename std::vector<ItemProxy>::iterator,
-		Item,
-		boost::random_access_traversal_tag
-	> Iterator;
-	typedef boost::indirect_iterator<
-		typename std::vector<ItemProxy>::const_iterator,
-		const Item,
-		boost::random_access_traversal_tag
-	> ConstIterator;
+	typedef typename std::vector<Item>::iterator Iterator;
+	typedef typename std::vector<Item>::const_iterator ConstIterator;
 	typedef std::reverse_iterator<Iterator> ReverseIterator;
 	typedef std::reverse_iterator<ConstIterator> ConstReverseIterator;
 	
@@ -228,20 +226,20 @@ public:
 	/// @param pos requested position
 	/// @return reference to item at given position
 	/// @throw std::out_of_range if given position is out of range
-	Menu<ItemT>::Item &at(size_t pos) { return *m_items.at(pos); }
+	Menu<ItemT>::Item &at(size_t pos) { return m_items.at(pos); }
 	
 	/// @param pos requested position
 	/// @return const reference to item at given position
 	/// @throw std::out_of_range if given position is out of range
-	const Menu<ItemT>::Item &at(size_t pos) const { return *m_items.at(pos); }
+	const Menu<ItemT>::Item &at(size_t pos) const { return m_items.at(pos); }
 	
 	/// @param pos requested position
 	/// @return const reference to item at given position
-	const Menu<ItemT>::Item &operator[](size_t pos) const  { return *m_items[pos]; }
+	const Menu<ItemT>::Item &operator[](size_t pos) const  { return m_items[pos]; }
 	
 	/// @param pos requested position
 	/// @return const reference to item at given position
-	Menu<ItemT>::Item &operator[](size_t pos) { return *m_items[pos]; }
+	Menu<ItemT>::Item &operator[](size_t pos) { return m_items[pos]; }
 	
 	Iterator current() { return Iterator(m_items.begin() + m_highlight); }
 	ConstIterator current() const { return ConstIterator(m_items.begin() + m_highlight); }
@@ -274,31 +272,15 @@ public:
 	ConstReverseValueIterator rendV() const { return ConstReverseValueIterator(beginV()); }
 	
 private:
-	struct ItemProxy
-	{
-		typedef Item element_type;
-		
-		ItemProxy() { }
-		ItemProxy(Item item) : m_ptr(std::make_shared<Item>(std::move(item))) { }
-		
-		Item &operator*() const { return *m_ptr; }
-		Item *operator->() const { return m_ptr.get(); }
-		
-		bool operator==(const ItemProxy &rhs) const { return m_ptr == rhs.m_ptr; }
-		
-	private:
-		std::shared_ptr<Item> m_ptr;
-	};
-	
 	bool isHighlightable(size_t pos)
 	{
-		return !m_items[pos]->isSeparator()
-		    && !m_items[pos]->isInactive();
+		return !m_items[pos].isSeparator()
+		    && !m_items[pos].isInactive();
 	}
 	
 	ItemDisplayer m_item_displayer;
 	
-	std::vector<ItemProxy> m_items;
+	std::vector<Item> m_items;
 	
 	size_t m_beginning;
 	size_t m_highlight;
@@ -338,6 +320,7 @@ template <typename ItemT>
 Menu<ItemT>::Menu(const Menu &rhs)
 : Window(rhs)
 , m_item_displayer(rhs.m_item_displayer)
+, m_items(rhs.m_items)
 , m_beginning(rhs.m_beginning)
 , m_highlight(rhs.m_highlight)
 , m_highlight_color(rhs.m_highlight_color)
@@ -348,10 +331,6 @@ Menu<ItemT>::Menu(const Menu &rhs)
 , m_selected_prefix(rhs.m_selected_prefix)
 , m_selected_suffix(rhs.m_selected_suffix)
 {
-	// there is no way to properly fill m_filtered_options
-	// (if rhs is filtered), so we just don't do it.
-	m_items.reserve(rhs.m_items.size());
-	std::copy(rhs.begin(), rhs.end(), std::back_inserter(m_items));
 }
 
 template <typename ItemT>
@@ -392,15 +371,7 @@ Menu<ItemT> &Menu<ItemT>::operator=(Menu rhs)
 template <typename ItemT>
 void Menu<ItemT>::resizeList(size_t new_size)
 {
-	if (new_size > m_items.size())
-	{
-		size_t old_size = m_items.size();
-		m_items.resize(new_size);
-		for (size_t i = old_size; i < new_size; ++i)
-			m_items[i] = Item();
-	}
-	else
-		m_items.resize(new_size);
+	m_items.resize(new_size);
 }
 
 template <typename ItemT>
@@ -481,12 +452,12 @@ void Menu<ItemT>::refresh()
 				mvwhline(m_window, line, 0, KEY_SPACE, m_width);
 			break;
 		}
-		if (m_items[i]->isSeparator())
+		if (m_items[i].isSeparator())
 		{
 			mvwhline(m_window, line, 0, 0, m_width);
 			continue;
 		}
-		if (m_items[i]->isBold())
+		if (m_items[i].isBold())
 			*this << Format::Bold;
 		if (m_highlight_enabled && i == m_highlight)
 		{
@@ -494,18 +465,18 @@ void Menu<ItemT>::refresh()
 			*this << m_highlight_color;
 		}
 		mvwhline(m_window, line, 0, KEY_SPACE, m_width);
-		if (m_items[i]->isSelected())
+		if (m_items[i].isSelected())
 			*this << m_selected_prefix;
 		if (m_item_displayer)
 			m_item_displayer(*this);
-		if (m_items[i]->isSelected())
+		if (m_items[i].isSelected())
 			*this << m_selected_suffix;
 		if (m_highlight_enabled && i == m_highlight)
 		{
 			*this << Color::End;
 			*this << Format::NoReverse;
 		}
-		if (m_items[i]->isBold())
+		if (m_items[i].isBold())
 			*this << Format::NoBold;
 	}
 	Window::refresh();
@@ -20,6 +20,8 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <algorithm>
 #include <map>
 
@@ -27,10 +29,14 @@
 #include "error.h"
 #include "mpdpp.h"
 
-MPD::Connection Mpd;
+MPD::Connection Mpd(true);
 
 namespace {
 
+// mpd closes connections that are inactive for connection_timeout
+// seconds (60 by default), ping it well before that happens.
+const time_t KeepAliveInterval = 30;
+
 template <typename ObjectT, typename SourceT>
 std::function<bool(typename MPD::Iterator<ObjectT>::State &)>
 defaultFetcher(SourceT *(fetcher)(mpd_connection *))
@@ -47,31 +53,112 @@ defaultFetcher(SourceT *(fetcher)(mpd_connection *))
 	};
 }
 
-bool fetchItemSong(MPD::SongIterator::State &state)
+// Last-Modified values are in ISO 8601 format, e.g. 2014-05-01T12:00:00Z
+time_t parseMTime(const char *s)
+{
+	tm t;
+	memset(&t, 0, sizeof(t));
+	if (strptime(s, "%Y-%m-%dT%H:%M:%SZ", &t) == nullptr)
+		return 0;
+	return timegm(&t);
+}
+
+bool isEntityStart(const mpd_pair *pair)
+{
+	return strcmp(pair->name, "file") == 0
+	    || strcmp(pair->name, "directory") == 0
+	    || strcmp(pair->name, "playlist") == 0;
+}
+
+// Build the object directly from the pairs sent by the server, starting
+// with the one already received. This is what mpd_recv_entity does, but
+// it saves us from duplicating the object we would take out of the entity.
+template <typename SourceT>
+SourceT *recvObject(mpd_connection *connection, mpd_pair *pair,
+                    SourceT *(begin)(const mpd_pair *),
+                    bool (feed)(SourceT *, const mpd_pair *))
 {
-	auto src = mpd_recv_entity(state.connection());
-	while (src != nullptr && mpd_entity_get_type(src) != MPD_ENTITY_TYPE_SONG)
+	SourceT *object = begin(pair);
+	mpd_return_pair(connection, pair);
+	if (object == nullptr)
+		return nullptr;
+	while ((pair = mpd_recv_pair(connection)) != nullptr && !isEntityStart(pair))
 	{
-		mpd_entity_free(src);
-		src = mpd_recv_entity(state.connection());
+		feed(object, pair);
+		mpd_return_pair(connection, pair);
 	}
-	if (src != nullptr)
+	// this one belongs to the next object
+	if (pair != nullptr)
+		mpd_enqueue_pair(connection, pair);
+	return object;
+}
+
+bool fetchItem(MPD::ItemIterator::State &state)
+{
+	auto connection = state.connection();
+	while (mpd_pair *pair = mpd_recv_pair(connection))
 	{
-		state.setObject(mpd_song_dup(mpd_entity_get_song(src)));
-		mpd_entity_free(src);
-		return true;
+		if (strcmp(pair->name, "file") == 0)
+		{
+			auto song = recvObject(connection, pair, mpd_song_begin, mpd_song_feed);
+			if (song == nullptr)
+				return false;
+			state.setObject(MPD::Song(song));
+			return true;
+		}
+		else if (strcmp(pair->name, "directory") == 0)
+		{
+			auto directory = recvObject(connection, pair, mpd_directory_begin, mpd_directory_feed);
+			if (directory == nullptr)
+				return false;
+			state.setObject(MPD::Directory(directory));
+			mpd_directory_free(directory);
+			return true;
+		}
+		else if (strcmp(pair->name, "playlist") == 0)
+		{
+			auto playlist = recvObject(connection, pair, mpd_playlist_begin, mpd_playlist_feed);
+			if (playlist == nullptr)
+				return false;
+			state.setObject(MPD::Playlist(playlist));
+			mpd_playlist_free(playlist);
+			return true;
+		}
+		mpd_return_pair(connection, pair);
 	}
-	else
-		return false;
+	return false;
+}
+
+bool fetchItemSong(MPD::SongIterator::State &state)
+{
+	auto connection = state.connection();
+	while (mpd_pair *pair = mpd_recv_pair(connection))
+	{
+		if (strcmp(pair->name, "file") == 0)
+		{
+			auto song = recvObject(connection, pair, mpd_song_begin, mpd_song_feed);
+			if (song == nullptr)
+				return false;
+			state.setObject(song);
+			return true;
+		}
+		mpd_return_pair(connection, pair);
+	}
+	return false;
 }
 
 }
 
 namespace MPD {
 
-Connection::Connection() : m_connection(nullptr),
+Connection::Connection(bool with_idle_connection) : m_connection(nullptr),
+				m_idle_connection(nullptr),
 				m_command_list_active(false),
+				m_fd(-1),
+				m_idle_fd(-1),
 				m_idle(false),
+				m_with_idle_connection(with_idle_connection),
+				m_last_command(0),
 				m_host("localhost"),
 				m_port(6600),
 				m_timeout(15)
@@ -85,10 +172,21 @@ void Connection::Connect()
 	{
 		m_connection.reset(mpd_connection_new(m_host.c_str(), m_port, m_timeout * 1000));
 		checkErrors();
+		if (m_with_idle_connection)
+		{
+			m_idle_connection.reset(mpd_connection_new(m_host.c_str(), m_port, m_timeout * 1000));
+			checkErrors(m_idle_connection.get());
+		}
 		if (!m_password.empty())
 			SendPassword();
 		m_fd = mpd_connection_get_fd(m_connection.get());
 		checkErrors();
+		if (m_idle_connection)
+		{
+			m_idle_fd = mpd_connection_get_fd(m_idle_connection.get());
+			checkErrors(m_idle_connection.get());
+		}
+		m_last_command = time(nullptr);
 	}
 	catch (MPD::ClientError &e)
 	{
@@ -105,7 +203,11 @@ bool Connection::Connected() const
 void Connection::Disconnect()
 {
 	m_connection = nullptr;
+	m_idle_connection = nullptr;
 	m_command_list_active = false;
+	m_replies.clear();
+	m_fd = -1;
+	m_idle_fd = -1;
 	m_idle = false;
 }
 
@@ -129,19 +231,27 @@ void Connection::SetHostname(const std::string &host)
 void Connection::SendPassword()
 {
 	assert(m_connection);
-	noidle();
 	assert(!m_command_list_active);
 	mpd_run_password(m_connection.get(), m_password.c_str());
 	checkErrors();
+	if (m_idle_connection)
+	{
+		// the password needs to be sent on the idle connection too,
+		// it will enter the idle mode again on the next idle() call
+		noidle();
+		mpd_run_password(m_idle_connection.get(), m_password.c_str());
+		checkErrors(m_idle_connection.get());
+	}
 }
 
 void Connection::idle()
 {
 	checkConnection();
+	assert(m_idle_connection);
 	if (!m_idle)
 	{
-		mpd_send_idle(m_connection.get());
-		checkErrors();
+		mpd_send_idle(m_idle_connection.get());
+		checkErrors(m_idle_connection.get());
 	}
 	m_idle = true;
 }
@@ -149,17 +259,28 @@ void Connection::idle()
 int Connection::noidle()
 {
 	checkConnection();
+	assert(m_idle_connection);
 	int flags = 0;
-	if (m_idle && mpd_send_noidle(m_connection.get()))
+	if (m_idle && mpd_send_noidle(m_idle_connection.get()))
 	{
 		m_idle = false;
-		flags = mpd_recv_idle(m_connection.get(), true);
-		mpd_response_finish(m_connection.get());
-		checkErrors();
+		flags = mpd_recv_idle(m_idle_connection.get(), true);
+		mpd_response_finish(m_idle_connection.get());
+		checkErrors(m_idle_connection.get());
 	}
 	return flags;
 }
 
+void Connection::keepAlive()
+{
+	if (m_command_list_active || time(nullptr) - m_last_command < KeepAliveInterval)
+		return;
+	prechecks();
+	mpd_send_command(m_connection.get(), "ping", nullptr);
+	mpd_response_finish(m_connection.get());
+	checkErrors();
+}
+
 Statistics Connection::getStatistics()
 {
 	prechecks();
@@ -243,7 +364,10 @@ void Connection::Move(unsigned from, unsigned to)
 {
 	prechecks();
 	if (m_command_list_active)
+	{
 		mpd_send_move(m_connection.get(), from, to);
+		queueReply();
+	}
 	else
 	{
 		mpd_run_move(m_connection.get(), from, to);
@@ -251,11 +375,29 @@ void Connection::Move(unsigned from, unsigned to)
 	}
 }
 
+void Connection::MoveRange(unsigned start, unsigned end, unsigned to)
+{
+	prechecks();
+	if (m_command_list_active)
+	{
+		mpd_send_move_range(m_connection.get(), start, end, to);
+		queueReply();
+	}
+	else
+	{
+		mpd_run_move_range(m_connection.get(), start, end, to);
+		checkErrors();
+	}
+}
+
 void Connection::Swap(unsigned from, unsigned to)
 {
 	prechecks();
 	if (m_command_list_active)
+	{
 		mpd_send_swap(m_connection.get(), from, to);
+		queueReply();
+	}
 	else
 	{
 		mpd_run_swap(m_connection.get(), from, to);
@@ -300,7 +442,10 @@ void Connection::AddToPlaylist(const std::string &path, const std::string &file)
 {
 	prechecks();
 	if (m_command_list_active)
+	{
 		mpd_send_playlist_add(m_connection.get(), path.c_str(), file.c_str());
+		queueReply();
+	}
 	else
 	{
 		mpd_run_playlist_add(m_connection.get(), path.c_str(), file.c_str());
@@ -312,7 +457,10 @@ void Connection::PlaylistMove(const std::string &path, int from, int to)
 {
 	prechecks();
 	if (m_command_list_active)
+	{
 		mpd_send_playlist_move(m_connection.get(), path.c_str(), from, to);
+		queueReply();
+	}
 	else
 	{
 		mpd_send_playlist_move(m_connection.get(), path.c_str(), from, to);
@@ -336,6 +484,27 @@ SongIterator Connection::GetPlaylistChanges(unsigned version)
 	return SongIterator(m_connection.get(), defaultFetcher<Song>(mpd_recv_song));
 }
 
+std::vector<std::pair<unsigned, unsigned>> Connection::GetPlaylistChangesPosId(unsigned version)
+{
+	prechecksNoCommandsList();
+	mpd_send_queue_changes_brief(m_connection.get(), version);
+	std::vector<std::pair<unsigned, unsigned>> result;
+	unsigned pos, id;
+	while (mpd_recv_queue_change_brief(m_connection.get(), &pos, &id))
+		result.push_back(std::make_pair(pos, id));
+	mpd_response_finish(m_connection.get());
+	checkErrors();
+	return result;
+}
+
+SongIterator Connection::GetPlaylistRange(unsigned start, unsigned end)
+{
+	prechecksNoCommandsList();
+	mpd_send_list_queue_range_meta(m_connection.get(), start, end);
+	checkErrors();
+	return SongIterator(m_connection.get(), defaultFetcher<Song>(mpd_recv_song));
+}
+
 Song Connection::GetCurrentSong()
 {
 	prechecksNoCommandsList();
@@ -477,7 +646,10 @@ void Connection::SetPriority(const Song &s, int prio)
 {
 	prechecks();
 	if (m_command_list_active)
+	{
 		mpd_send_prio_id(m_connection.get(), prio, s.getID());
+		queueReply();
+	}
 	else
 	{
 		mpd_run_prio_id(m_connection.get(), prio, s.getID());
@@ -500,7 +672,10 @@ int Connection::AddSong(const std::string &path, int pos)
 		checkErrors();
 	}
 	else
+	{
+		queueReply();
 		id = 0;
+	}
 	return id;
 }
 
@@ -509,11 +684,41 @@ int Connection::AddSong(const Song &s, int pos)
 	return AddSong((!s.isFromDatabase() ? "file://" : "") + s.getURI(), pos);
 }
 
+boost::future<int> Connection::AddSongAsync(const std::string &path, int pos)
+{
+	if (!m_command_list_active)
+	{
+		boost::promise<int> id;
+		id.set_value(AddSong(path, pos));
+		return id.get_future();
+	}
+	prechecks();
+	if (pos < 0)
+		mpd_send_add_id(m_connection.get(), path.c_str());
+	else
+		mpd_send_add_id_to(m_connection.get(), path.c_str(), pos);
+	return queueReply<int>([](mpd_connection *c, boost::promise<int> &id) {
+		int song_id = mpd_recv_song_id(c);
+		if (song_id < 0)
+			return false;
+		id.set_value(song_id);
+		return true;
+	});
+}
+
+boost::future<int> Connection::AddSongAsync(const Song &s, int pos)
+{
+	return AddSongAsync((!s.isFromDatabase() ? "file://" : "") + s.getURI(), pos);
+}
+
 void Connection::Add(const std::string &path)
 {
 	prechecks();
 	if (m_command_list_active)
+	{
 		mpd_send_add(m_connection.get(), path.c_str());
+		queueReply();
+	}
 	else
 	{
 		mpd_run_add(m_connection.get(), path.c_str());
@@ -548,20 +753,10 @@ bool Connection::AddRandomTag(mpd_tag_type tag, size_t number)
 	return true;
 }
 
-bool Connection::AddRandomSongs(size_t number)
+bool Connection::AddRandomSongs(size_t number, const std::vector<Song> &songs)
 {
 	prechecksNoCommandsList();
-	std::vector<std::string> files;
-	mpd_send_list_all(m_connection.get(), "/");
-	while (mpd_pair *item = mpd_recv_pair_named(m_connection.get(), "file"))
-	{
-		files.push_back(item->value);
-		mpd_return_pair(m_connection.get(), item);
-	}
-	mpd_response_finish(m_connection.get());
-	checkErrors();
-	
-	if (number > files.size())
+	if (number > songs.size())
 	{
 		//if (itsErrorHandler)
 		//	itsErrorHandler(this, 0, "Requested number of random songs is bigger than size of your library", itsErrorHandlerUserdata);
@@ -569,11 +764,13 @@ bool Connection::AddRandomSongs(size_t number)
 	}
 	else
 	{
-		std::random_shuffle(files.begin(), files.end());
+		std::vector<size_t> indices(songs.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+			indices[i] = i;
+		std::random_shuffle(indices.begin(), indices.end());
 		StartCommandsList();
-		auto it = files.begin();
-		for (size_t i = 0; i < number && it != files.end(); ++i, ++it)
-			AddSong(*it);
+		for (size_t i = 0; i < number; ++i)
+			AddSong(songs[indices[i]]);
 		CommitCommandsList();
 	}
 	return true;
@@ -588,6 +785,8 @@ void Connection::Delete(unsigned pos)
 		mpd_response_finish(m_connection.get());
 		checkErrors();
 	}
+	else
+		queueReply();
 }
 
 void Connection::PlaylistDelete(const std::string &playlist, unsigned pos)
@@ -599,6 +798,8 @@ void Connection::PlaylistDelete(const std::string &playlist, unsigned pos)
 		mpd_response_finish(m_connection.get());
 		checkErrors();
 	}
+	else
+		queueReply();
 }
 
 void Connection::StartCommandsList()
@@ -613,10 +814,8 @@ void Connection::CommitCommandsList()
 {
 	prechecks();
 	assert(m_command_list_active);
-	mpd_command_list_end(m_connection.get());
-	mpd_response_finish(m_connection.get());
 	m_command_list_active = false;
-	checkErrors();
+	receiveReplies();
 }
 
 void Connection::DeletePlaylist(const std::string &name)
@@ -698,6 +897,14 @@ void Connection::AddSearchURI(const std::string &str) const
 	mpd_search_add_uri_constraint(m_connection.get(), MPD_OPERATOR_DEFAULT, str.c_str());
 }
 
+#if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+void Connection::AddSearchModifiedSince(time_t mtime) const
+{
+	checkConnection();
+	mpd_search_add_modified_since_constraint(m_connection.get(), MPD_OPERATOR_DEFAULT, mtime);
+}
+#endif // LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+
 SongIterator Connection::CommitSearchSongs()
 {
 	prechecksNoCommandsList();
@@ -711,7 +918,7 @@ ItemIterator Connection::GetDirectory(const std::string &directory)
 	prechecksNoCommandsList();
 	mpd_send_list_meta(m_connection.get(), directory.c_str());
 	checkErrors();
-	return ItemIterator(m_connection.get(), defaultFetcher<Item>(mpd_recv_entity));
+	return ItemIterator(m_connection.get(), fetchItem);
 }
 
 SongIterator Connection::GetDirectoryRecursive(const std::string &directory)
@@ -722,6 +929,61 @@ SongIterator Connection::GetDirectoryRecursive(const std::string &directory)
 	return SongIterator(m_connection.get(), fetchItemSong);
 }
 
+StringIterator Connection::GetURIsRecursive(const std::string &directory)
+{
+	prechecksNoCommandsList();
+	mpd_send_list_all(m_connection.get(), directory.c_str());
+	checkErrors();
+	return StringIterator(m_connection.get(), [](StringIterator::State &state) {
+		auto src = mpd_recv_pair_named(state.connection(), "file");
+		if (src != nullptr)
+		{
+			state.setObject(src->value);
+			mpd_return_pair(state.connection(), src);
+			return true;
+		}
+		else
+			return false;
+	});
+}
+
+std::vector<std::pair<std::string, time_t>> Connection::GetFilesMTimes(const std::vector<std::string> &directories)
+{
+	prechecksNoCommandsList();
+	std::vector<std::pair<std::string, time_t>> result;
+	if (directories.empty())
+		return result;
+	mpd_command_list_begin(m_connection.get(), true);
+	for (auto it = directories.begin(); it != directories.end(); ++it)
+		mpd_send_command(m_connection.get(), "listfiles", it->c_str(), nullptr);
+	mpd_command_list_end(m_connection.get());
+	checkErrors();
+	for (auto it = directories.begin(); it != directories.end(); ++it)
+	{
+		std::string prefix = it->empty() ? "" : *it + "/";
+		bool is_file = false;
+		while (mpd_pair *pair = mpd_recv_pair(m_connection.get()))
+		{
+			if (strcmp(pair->name, "file") == 0)
+			{
+				result.push_back(std::make_pair(prefix + pair->value, 0));
+				is_file = true;
+			}
+			else if (strcmp(pair->name, "directory") == 0)
+				is_file = false;
+			else if (is_file && strcmp(pair->name, "Last-Modified") == 0)
+				result.back().second = parseMTime(pair->value);
+			mpd_return_pair(m_connection.get(), pair);
+		}
+		// this fails if one of the commands failed
+		if (it+1 != directories.end() && !mpd_response_next(m_connection.get()))
+			break;
+	}
+	mpd_response_finish(m_connection.get());
+	checkErrors();
+	return result;
+}
+
 DirectoryIterator Connection::GetDirectories(const std::string &directory)
 {
 	prechecksNoCommandsList();
@@ -806,7 +1068,7 @@ void Connection::checkConnection() const
 void Connection::prechecks()
 {
 	checkConnection();
-	noidle();
+	m_last_command = time(nullptr);
 }
 
 void Connection::prechecksNoCommandsList()
@@ -815,21 +1077,93 @@ void Connection::prechecksNoCommandsList()
 	prechecks();
 }
 
+template <typename ValueT, typename ReceiverT>
+boost::future<ValueT> Connection::queueReply(ReceiverT receiver)
+{
+	assert(m_command_list_active);
+	auto value = std::make_shared<boost::promise<ValueT>>();
+	Reply reply;
+	reply.receive = [value, receiver](mpd_connection *c) {
+		return receiver(c, *value);
+	};
+	reply.cancel = [value](boost::exception_ptr e) {
+		value->set_exception(e);
+	};
+	m_replies.push_back(std::move(reply));
+	return value->get_future();
+}
+
+void Connection::queueReply()
+{
+	assert(m_command_list_active);
+	m_replies.push_back(Reply());
+}
+
+void Connection::receiveReplies()
+{
+	// all commands were sent in one batch, now read the replies
+	// in the same order and pass them to their receivers.
+	auto replies = std::move(m_replies);
+	m_replies.clear();
+	mpd_command_list_end(m_connection.get());
+	auto reply = replies.begin();
+	for (; reply != replies.end(); ++reply)
+	{
+		if (reply->receive && !reply->receive(m_connection.get()))
+			break;
+		if (!mpd_response_next(m_connection.get()))
+		{
+			++reply;
+			break;
+		}
+	}
+	mpd_response_finish(m_connection.get());
+	auto cancel_remaining = [&](boost::exception_ptr e) {
+		for (; reply != replies.end(); ++reply)
+			if (reply->cancel)
+				reply->cancel(e);
+	};
+	try
+	{
+		checkErrors();
+	}
+	catch (ServerError &e)
+	{
+		cancel_remaining(boost::copy_exception(e));
+		throw;
+	}
+	catch (ClientError &e)
+	{
+		cancel_remaining(boost::copy_exception(e));
+		throw;
+	}
+	// if we didn't get all the replies, something is wrong
+	if (reply != replies.end())
+		cancel_remaining(boost::copy_exception(
+			ClientError(MPD_ERROR_MALFORMED, "Missing reply to command", true)
+		));
+}
+
 void Connection::checkErrors() const
 {
-	mpd_error code = mpd_connection_get_error(m_connection.get());
+	checkErrors(m_connection.get());
+}
+
+void Connection::checkErrors(mpd_connection *connection) const
+{
+	mpd_error code = mpd_connection_get_error(connection);
 	if (code != MPD_ERROR_SUCCESS)
 	{
-		std::string msg = mpd_connection_get_error_message(m_connection.get());
+		std::string msg = mpd_connection_get_error_message(connection);
 		if (code == MPD_ERROR_SERVER)
 		{
-			mpd_server_error server_code = mpd_connection_get_server_error(m_connection.get());
-			bool clearable = mpd_connection_clear_error(m_connection.get());
+			mpd_server_error server_code = mpd_connection_get_server_error(connection);
+			bool clearable = mpd_connection_clear_error(connection);
 			throw ServerError(server_code, msg, clearable);
 		}
 		else
 		{
-			bool clearable = mpd_connection_clear_error(m_connection.get());
+			bool clearable = mpd_connection_clear_error(connection);
 			throw ClientError(code, msg, clearable);
 		}
 	}
@@ -21,11 +21,15 @@
 #ifndef NCMPCPP_MPDPP_H
 #define NCMPCPP_MPDPP_H
 
+#include "config.h"
+
 #include <cassert>
 #include <exception>
+#include <functional>
 #include <set>
 #include <vector>
 
+#include <boost/thread/future.hpp>
 #include <mpd/client.h>
 #include "song.h"
 
@@ -207,28 +211,6 @@ struct Item
 {
 	enum class Type { Directory, Song, Playlist };
 
-	Item(mpd_entity *entity)
-	{
-		assert(entity != nullptr);
-		switch (mpd_entity_get_type(entity))
-		{
-			case MPD_ENTITY_TYPE_DIRECTORY:
-				m_type = Type::Directory;
-				m_directory = Directory(mpd_entity_get_directory(entity));
-				break;
-			case MPD_ENTITY_TYPE_SONG:
-				m_type = Type::Song;
-				m_song = Song(mpd_song_dup(mpd_entity_get_song(entity)));
-				break;
-			case MPD_ENTITY_TYPE_PLAYLIST:
-				m_type = Type::Playlist;
-				m_playlist = Playlist(mpd_entity_get_playlist(entity));
-				break;
-			default:
-				throw std::runtime_error("unknown mpd_entity type");
-		}
-		mpd_entity_free(entity);
-	}
 	Item(Directory directory_)
 	: m_type(Type::Directory)
 	, m_directory(std::move(directory_))
@@ -453,7 +435,9 @@ typedef Iterator<std::string> StringIterator;
 
 struct Connection
 {
-	Connection();
+	// connection used for the idle mode is opened only if requested,
+	// connections that never enter it don't need it.
+	Connection(bool with_idle_connection = false);
 	
 	void Connect();
 	bool Connected() const;
@@ -461,10 +445,13 @@ struct Connection
 	
 	const std::string &GetHostname() { return m_host; }
 	int GetPort() { return m_port; }
+	int GetTimeout() { return m_timeout; }
+	const std::string &GetPassword() { return m_password; }
 	
 	unsigned Version() const;
 	
 	int GetFD() const { return m_fd; }
+	int GetIdleFD() const { return m_idle_fd; }
 	
 	void SetHostname(const std::string &);
 	void SetPort(int port) { m_port = port; }
@@ -486,6 +473,7 @@ struct Connection
 	void Next();
 	void Prev();
 	void Move(unsigned int from, unsigned int to);
+	void MoveRange(unsigned start, unsigned end, unsigned to);
 	void Swap(unsigned, unsigned);
 	void Seek(unsigned int pos, unsigned int where);
 	void Shuffle();
@@ -493,6 +481,10 @@ struct Connection
 	
 	SongIterator GetPlaylistChanges(unsigned);
 	
+	// positions and ids of songs that changed since given playlist version
+	std::vector<std::pair<unsigned, unsigned>> GetPlaylistChangesPosId(unsigned version);
+	SongIterator GetPlaylistRange(unsigned start, unsigned end);
+	
 	Song GetCurrentSong();
 	Song GetSong(const std::string &);
 	SongIterator GetPlaylistContent(const std::string &name);
@@ -514,8 +506,12 @@ struct Connection
 	
 	int AddSong(const std::string &, int = -1); // returns id of added song
 	int AddSong(const Song &, int = -1); // returns id of added song
+	// within commands list ids of added songs become available
+	// after the list is committed, so that it takes one round trip
+	boost::future<int> AddSongAsync(const std::string &, int = -1);
+	boost::future<int> AddSongAsync(const Song &, int = -1);
 	bool AddRandomTag(mpd_tag_type, size_t);
-	bool AddRandomSongs(size_t);
+	bool AddRandomSongs(size_t number, const std::vector<Song> &songs);
 	void Add(const std::string &path);
 	void Delete(unsigned int pos);
 	void PlaylistDelete(const std::string &playlist, unsigned int pos);
@@ -536,12 +532,19 @@ struct Connection
 	void AddSearch(mpd_tag_type item, const std::string &str) const;
 	void AddSearchAny(const std::string &str) const;
 	void AddSearchURI(const std::string &str) const;
+#	if LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
+	void AddSearchModifiedSince(time_t mtime) const;
+#	endif // LIBMPDCLIENT_CHECK_VERSION(2, 10, 0)
 	SongIterator CommitSearchSongs();
 	
 	PlaylistIterator GetPlaylists();
 	StringIterator GetList(mpd_tag_type type);
 	ItemIterator GetDirectory(const std::string &directory);
 	SongIterator GetDirectoryRecursive(const std::string &directory);
+	StringIterator GetURIsRecursive(const std::string &directory);
+	// uris and modification times of files in given directories of
+	// music storage, which may include files that are not songs.
+	std::vector<std::pair<std::string, time_t>> GetFilesMTimes(const std::vector<std::string> &directories);
 	SongIterator GetSongs(const std::string &directory);
 	DirectoryIterator GetDirectories(const std::string &directory);
 	
@@ -552,9 +555,15 @@ struct Connection
 	StringIterator GetURLHandlers();
 	StringIterator GetTagTypes();
 	
+	// idle mode is handled by separate connection, so
+	// that commands don't need to wait for noidle.
 	void idle();
 	int noidle();
 	
+	// command connection is not in idle mode, so it needs to send a command
+	// once in a while for the server not to close it due to inactivity.
+	void keepAlive();
+	
 private:
 	struct ConnectionDeleter {
 		void operator()(mpd_connection *connection) {
@@ -562,16 +571,36 @@ private:
 		}
 	};
 
+	// reply to a command sent within the command list. receive is
+	// called when the reply arrives, cancel if the command failed or
+	// was not executed because one of the previous commands failed.
+	struct Reply
+	{
+		std::function<bool(mpd_connection *)> receive;
+		std::function<void(boost::exception_ptr)> cancel;
+	};
+
 	void checkConnection() const;
 	void prechecks();
 	void prechecksNoCommandsList();
 	void checkErrors() const;
+	void checkErrors(mpd_connection *connection) const;
+
+	template <typename ValueT, typename ReceiverT>
+	boost::future<ValueT> queueReply(ReceiverT receiver);
+	void queueReply();
+	void receiveReplies();
 
 	std::unique_ptr<mpd_connection, ConnectionDeleter> m_connection;
+	std::unique_ptr<mpd_connection, ConnectionDeleter> m_idle_connection;
 	bool m_command_list_active;
+	std::vector<Reply> m_replies;
 	
 	int m_fd;
+	int m_idle_fd;
 	bool m_idle;
+	bool m_with_idle_connection;
+	time_t m_last_command;
 	
 	std::string m_host;
 	int m_port;
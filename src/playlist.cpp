@@ -42,13 +42,16 @@ Playlist *myPlaylist;
 
 namespace {
 
+const size_t MaxMembershipChanges = 65536;
+
 std::string songToString(const MPD::Song &s);
 bool playlistEntryMatcher(const boost::regex &rx, const MPD::Song &s);
 
 }
 
 Playlist::Playlist()
-: m_total_length(0), m_remaining_time(0), m_scroll_begin(0)
+: m_membership_offset(0), m_updating(false)
+, m_total_length(0), m_remaining_time(0), m_scroll_begin(0)
 , m_timer(boost::posix_time::from_time_t(0))
 , m_reload_total_length(false), m_reload_remaining(false)
 {
@@ -161,9 +164,14 @@ bool Playlist::allowsSearching()
 
 void Playlist::setSearchConstraint(const std::string &constraint)
 {
-	m_search_predicate = RegexFilter<MPD::Song>(
-		boost::regex(constraint, Config.regex_type), playlistEntryMatcher
-	);
+	if (Config.fuzzy_find)
+		m_search_predicate = RegexFilter<MPD::Song>(
+			FuzzyPattern(constraint), fuzzySongScore
+		);
+	else
+		m_search_predicate = RegexFilter<MPD::Song>(
+			boost::regex(constraint, Config.regex_type), playlistEntryMatcher
+		);
 }
 
 void Playlist::clearConstraint()
@@ -213,9 +221,10 @@ MPD::Song Playlist::nowPlayingSong()
 	MPD::Song s;
 	if (Status::State::player() != MPD::psUnknown)
 	{
-		auto sp = Status::State::currentSongPosition();
-		if (sp >= 0 && size_t(sp) < w.size())
-			s = w.at(sp).value();
+		auto id = Status::State::currentSongID();
+		int pos = id >= 0 ? songPosition(id) : -1;
+		if (pos >= 0)
+			s = w.at(pos).value();
 	}
 	return s;
 }
@@ -244,16 +253,23 @@ std::string Playlist::getTotalLength()
 	
 	if (m_reload_total_length)
 	{
-		m_total_length = 0;
-		for (const auto &s : w)
-			m_total_length += s.value().getDuration();
+		// rebuild lengths if they somehow got out of sync with the playlist
+		if (m_song_lengths.size() != w.size())
+		{
+			m_song_lengths.clear();
+			for (const auto &s : w)
+				m_song_lengths.push_back(s.value().getDuration());
+		}
+		m_total_length = m_song_lengths.total();
 		m_reload_total_length = false;
 	}
 	if (Config.playlist_show_remaining_time && m_reload_remaining)
 	{
-		m_remaining_time = 0;
-		for (size_t i = Status::State::currentSongPosition(); i < w.size(); ++i)
-			m_remaining_time += w[i].value().getDuration();
+		size_t pos = Status::State::currentSongPosition();
+		if (pos < m_song_lengths.size())
+			m_remaining_time = m_total_length - m_song_lengths.sum(pos);
+		else
+			m_remaining_time = 0;
 		m_reload_remaining = false;
 	}
 	
@@ -285,22 +301,118 @@ void Playlist::SetSelectedItemsPriority(int prio)
 
 bool Playlist::checkForSong(const MPD::Song &s)
 {
-	return m_song_refs.find(s) != m_song_refs.end();
+	return m_song_positions.find(s) != m_song_positions.end();
 }
 
 void Playlist::registerSong(const MPD::Song &s)
 {
-	++m_song_refs[s];
+	auto &positions = m_song_positions[s];
+	positions.push_back(s.getPosition());
+	if (positions.size() == 1)
+		addMembershipChange(s);
+	m_song_ids[s.getID()] = s.getPosition();
 }
 
 void Playlist::unregisterSong(const MPD::Song &s)
 {
-	auto it = m_song_refs.find(s);
-	assert(it != m_song_refs.end());
-	if (it->second == 1)
-		m_song_refs.erase(it);
-	else
-		--it->second;
+	auto it = m_song_positions.find(s);
+	assert(it != m_song_positions.end());
+	auto &positions = it->second;
+	auto pos = std::find(positions.begin(), positions.end(), s.getPosition());
+	assert(pos != positions.end());
+	positions.erase(pos);
+	if (positions.empty())
+	{
+		m_song_positions.erase(it);
+		addMembershipChange(s);
+	}
+	// song with the same id might've been already registered
+	// at another position if it was moved, keep it then
+	auto id = m_song_ids.find(s.getID());
+	if (id != m_song_ids.end() && id->second == s.getPosition())
+		m_song_ids.erase(id);
+}
+
+void Playlist::beginUpdate()
+{
+	assert(!m_updating);
+	m_updating = true;
+}
+
+void Playlist::endUpdate()
+{
+	assert(m_updating);
+	m_updating = false;
+	for (auto it = m_membership_update.begin(); it != m_membership_update.end(); ++it)
+		if (it->second != checkForSong(it->first))
+			addMembershipChange(it->first);
+	m_membership_update.clear();
+}
+
+int Playlist::songPosition(unsigned id) const
+{
+	auto it = m_song_ids.find(id);
+	return it != m_song_ids.end() ? it->second : -1;
+}
+
+const std::vector<size_t> &Playlist::songPositions(const MPD::Song &s) const
+{
+	static const std::vector<size_t> none;
+	auto it = m_song_positions.find(s);
+	return it != m_song_positions.end() ? it->second : none;
+}
+
+size_t Playlist::membershipVersion() const
+{
+	return m_membership_offset + m_membership_changes.size();
+}
+
+bool Playlist::membershipChanges(size_t version, std::vector<MPD::Song>::const_iterator &first,
+                                 std::vector<MPD::Song>::const_iterator &last) const
+{
+	if (version < m_membership_offset || version > membershipVersion())
+		return false;
+	first = m_membership_changes.begin() + (version - m_membership_offset);
+	last = m_membership_changes.end();
+	return true;
+}
+
+void Playlist::addMembershipChange(const MPD::Song &s)
+{
+	if (m_updating)
+	{
+		// the change is already made, so the song was in the playlist
+		// before only if it isn't now. the first change is what counts.
+		m_membership_update.insert(std::make_pair(s, !checkForSong(s)));
+		return;
+	}
+	// forget older half of changes if there are too many of them, lists
+	// that didn't catch up with them need to be checked as a whole anyway
+	if (m_membership_changes.size() == MaxMembershipChanges)
+	{
+		size_t half = MaxMembershipChanges/2;
+		m_membership_changes.erase(m_membership_changes.begin(), m_membership_changes.begin()+half);
+		m_membership_offset += half;
+	}
+	m_membership_changes.push_back(s);
+}
+
+void Playlist::setSongLength(size_t pos, unsigned length)
+{
+	if (pos < m_song_lengths.size())
+		m_song_lengths.set(pos, length);
+	else if (pos == m_song_lengths.size())
+		m_song_lengths.push_back(length);
+	// otherwise lengths are out of sync and will be rebuilt
+	m_reload_total_length = true;
+	m_reload_remaining = true;
+}
+
+void Playlist::truncateSongLengths(size_t size)
+{
+	m_song_lengths.truncate(size);
+	m_reload_total_length = true;
+	m_reload_remaining = true;
 }
 
 namespace {
@@ -28,6 +28,7 @@
 #include "regex_filter.h"
 #include "screen.h"
 #include "song.h"
+#include "utility/fenwick_tree.h"
 
 struct Playlist: Screen<NC::Menu<MPD::Song>>, HasSongs, Searchable, Tabbable
 {
@@ -74,7 +75,30 @@ struct Playlist: Screen<NC::Menu<MPD::Song>>, HasSongs, Searchable, Tabbable
 	void registerSong(const MPD::Song &s);
 	void unregisterSong(const MPD::Song &s);
 	
-	void reloadTotalLength() { m_reload_total_length = true; }
+	// songs (un)registered in between are recorded as membership changes
+	// only when the update ends and if they entered or left the playlist,
+	// so that songs that were just moved within it are left out
+	void beginUpdate();
+	void endUpdate();
+	
+	// position of the song with given id, -1 if it's not in the playlist
+	int songPosition(unsigned id) const;
+	
+	// positions of all occurrences of given song in the playlist
+	const std::vector<size_t> &songPositions(const MPD::Song &s) const;
+	
+	// version of the set of songs in the playlist, i.e. number
+	// of times a song was added to or removed from it
+	size_t membershipVersion() const;
+	
+	// gets songs that were added to or removed from the playlist since given
+	// version, returns false if they're not known anymore
+	bool membershipChanges(size_t version, std::vector<MPD::Song>::const_iterator &first,
+	                       std::vector<MPD::Song>::const_iterator &last) const;
+	
+	void setSongLength(size_t pos, unsigned length);
+	void truncateSongLengths(size_t size);
+	
 	void reloadRemaining() { m_reload_remaining = true; }
 	
 protected:
@@ -82,12 +106,30 @@ protected:
 	
 private:
 	std::string getTotalLength();
+	void addMembershipChange(const MPD::Song &s);
 
 	std::string m_stats;
 	
-	std::unordered_map<MPD::Song, int, MPD::Song::Hash> m_song_refs;
+	// indexes of positions of songs in the playlist, kept
+	// up to date with it by (un)registering its songs
+	std::unordered_map<MPD::Song, std::vector<size_t>, MPD::Song::Hash> m_song_positions;
+	std::unordered_map<unsigned, size_t> m_song_ids;
+	
+	// songs that were recently added to or removed from the playlist,
+	// the first one changed membership version m_membership_offset
+	std::vector<MPD::Song> m_membership_changes;
+	size_t m_membership_offset;
+	
+	// songs that changed membership during the current update
+	// along with information whether they were in the playlist
+	std::unordered_map<MPD::Song, bool, MPD::Song::Hash> m_membership_update;
+	bool m_updating;
+	
+	// lengths of songs in the playlist, kept up to date
+	// with it so that statistics don't need a full scan
+	FenwickTree<size_t> m_song_lengths;
 	
-	size_t m_total_length;;
+	size_t m_total_length;
 	size_t m_remaining_time;
 	size_t m_scroll_begin;
 	
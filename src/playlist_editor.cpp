@@ -131,7 +131,7 @@ void PlaylistEditor::refresh()
 void PlaylistEditor::switchTo()
 {
 	SwitchTo::execute(this);
-	markSongsInPlaylist(contentProxyList());
+	markSongsInPlaylist();
 	drawHeader();
 	refresh();
 }
@@ -151,7 +151,7 @@ void PlaylistEditor::update()
 		};
 		if (idx < Playlists.size())
 			Playlists.resizeList(idx);
-		std::sort(Playlists.beginV(), Playlists.endV(),
+		sortByKeys(Playlists.beginV(), Playlists.endV(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		Playlists.refresh();
 	}
@@ -160,6 +160,7 @@ void PlaylistEditor::update()
 	||  m_content_update_requested)
 	{
 		m_content_update_requested = false;
+		m_playlist_marker.invalidate();
 		if (Playlists.empty())
 			Content.clear();
 		else
@@ -222,6 +223,11 @@ ProxySongList PlaylistEditor::contentProxyList()
 	});
 }
 
+void PlaylistEditor::markSongsInPlaylist()
+{
+	m_playlist_marker.mark(contentProxyList());
+}
+
 void PlaylistEditor::AddToPlaylist(bool add_n_play)
 {
 	if (isActiveWindow(Playlists) && !Playlists.empty())
@@ -343,10 +349,15 @@ void PlaylistEditor::setSearchConstraint(const std::string &constraint)
 	}
 	else if (isActiveWindow(Content))
 	{
-		m_content_search_predicate = RegexFilter<MPD::Song>(
-			boost::regex(constraint, Config.regex_type),
-			SongEntryMatcher
-		);
+		if (Config.fuzzy_find)
+			m_content_search_predicate = RegexFilter<MPD::Song>(
+				FuzzyPattern(constraint), fuzzySongScore
+			);
+		else
+			m_content_search_predicate = RegexFilter<MPD::Song>(
+				boost::regex(constraint, Config.regex_type),
+				SongEntryMatcher
+			);
 	}
 }
 
@@ -76,6 +76,7 @@ struct PlaylistEditor: Screen<NC::Window *>, HasColumns, HasSongs, Searchable, T
 	
 	virtual void Locate(const MPD::Playlist &playlist);
 	ProxySongList contentProxyList();
+	void markSongsInPlaylist();
 	
 	NC::Menu<MPD::Playlist> Playlists;
 	NC::Menu<MPD::Song> Content;
@@ -96,6 +97,8 @@ private:
 
 	RegexFilter<MPD::Playlist> m_playlists_search_predicate;
 	RegexFilter<MPD::Song> m_content_search_predicate;
+	
+	SongsInPlaylistMarker m_playlist_marker;
 };
 
 extern PlaylistEditor *myPlaylistEditor;
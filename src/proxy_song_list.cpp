@@ -0,0 +1,68 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include "playlist.h"
+#include "proxy_song_list.h"
+
+void SongsInPlaylistMarker::mark(ProxySongList pl)
+{
+	size_t list_size = pl.size();
+	std::vector<MPD::Song>::const_iterator first, last;
+	if (m_valid
+	&&  myPlaylist->membershipChanges(m_version, first, last)
+	&&  size_t(last-first) < list_size)
+	{
+		bool positions_valid = true;
+		for (; first != last && positions_valid; ++first)
+		{
+			auto it = m_positions.find(*first);
+			if (it == m_positions.end())
+				continue;
+			bool in_playlist = myPlaylist->checkForSong(*first);
+			for (auto pos = it->second.begin(); pos != it->second.end(); ++pos)
+			{
+				// the list could have been reordered since
+				auto s = *pos < list_size ? pl.getSong(*pos) : 0;
+				if (!s || *s != *first)
+				{
+					positions_valid = false;
+					break;
+				}
+				pl.setBold(*pos, in_playlist);
+			}
+		}
+		if (positions_valid)
+		{
+			m_version = myPlaylist->membershipVersion();
+			return;
+		}
+	}
+	m_positions.clear();
+	for (size_t i = 0; i < list_size; ++i)
+	{
+		if (auto s = pl.getSong(i))
+		{
+			pl.setBold(i, myPlaylist->checkForSong(*s));
+			m_positions[*s].push_back(i);
+		}
+	}
+	m_version = myPlaylist->membershipVersion();
+	m_valid = true;
+}
@@ -21,6 +21,7 @@
 #ifndef NCMPCPP_PROXY_SONG_LIST_H
 #define NCMPCPP_PROXY_SONG_LIST_H
 
+#include <unordered_map>
 #include "menu.h"
 #include "song.h"
 
@@ -127,4 +128,23 @@ public:
 	operator bool() const { return m_impl.get() != 0; }
 };
 
+/// Marks songs of the list that are in the playlist (makes them bold).
+/// It remembers positions of songs in the list and the version of the
+/// playlist it's up to date with, so that after the playlist changes only
+/// songs that were added to or removed from it need to be marked again.
+class SongsInPlaylistMarker
+{
+	std::unordered_map<MPD::Song, std::vector<size_t>, MPD::Song::Hash> m_positions;
+	size_t m_version;
+	bool m_valid;
+	
+public:
+	SongsInPlaylistMarker() : m_version(0), m_valid(false) { }
+	
+	/// Has to be called when new songs are put into the list
+	void invalidate() { m_valid = false; }
+	
+	void mark(ProxySongList pl);
+};
+
 #endif // NCMPCPP_PROXY_SONG_LIST_H
@@ -23,36 +23,57 @@
 
 #include <boost/regex.hpp>
 #include <cassert>
+#include "utility/fuzzy_match.h"
 
+// Filters can also match items approximately, in which case they are
+// ranked, i.e. items are visited from the best matching one.
 template <typename T>
 struct RegexFilter
 {
 	typedef NC::Menu<T> MenuT;
 	typedef typename NC::Menu<T>::Item Item;
 	typedef std::function<bool(const boost::regex &, const T &)> FilterFunction;
+	typedef std::function<int(const FuzzyPattern &, const T &)> ScoreFunction;
 	
 	RegexFilter() { }
 	RegexFilter(boost::regex rx, FilterFunction filter)
 	: m_rx(std::move(rx)), m_filter(std::move(filter)) { }
+	RegexFilter(FuzzyPattern pattern, ScoreFunction score)
+	: m_pattern(std::move(pattern)), m_score(std::move(score)) { }
 
 	void clear()
 	{
 		m_filter = nullptr;
+		m_score = nullptr;
 	}
 
 	bool operator()(const Item &item) const {
 		assert(defined());
+		if (ranked())
+			return score(item) >= 0;
 		return m_filter(m_rx, item.value());
 	}
 
+	int score(const Item &item) const {
+		assert(ranked());
+		return m_score(m_pattern, item.value());
+	}
+
 	bool defined() const
 	{
-		return m_filter.operator bool();
+		return m_filter || m_score;
+	}
+
+	bool ranked() const
+	{
+		return m_score.operator bool();
 	}
 
 private:
 	boost::regex m_rx;
 	FilterFunction m_filter;
+	FuzzyPattern m_pattern;
+	ScoreFunction m_score;
 };
 
 template <typename T> struct RegexItemFilter
@@ -60,28 +81,46 @@ template <typename T> struct RegexItemFilter
 	typedef NC::Menu<T> MenuT;
 	typedef typename NC::Menu<T>::Item Item;
 	typedef std::function<bool(const boost::regex &, const Item &)> FilterFunction;
+	typedef std::function<int(const FuzzyPattern &, const Item &)> ScoreFunction;
 	
 	RegexItemFilter() { }
 	RegexItemFilter(boost::regex rx, FilterFunction filter)
 	: m_rx(std::move(rx)), m_filter(std::move(filter)) { }
+	RegexItemFilter(FuzzyPattern pattern, ScoreFunction score)
+	: m_pattern(std::move(pattern)), m_score(std::move(score)) { }
 	
 	void clear()
 	{
 		m_filter = nullptr;
+		m_score = nullptr;
 	}
 
 	bool operator()(const Item &item) {
+		if (ranked())
+			return score(item) >= 0;
 		return m_filter(m_rx, item);
 	}
 	
+	int score(const Item &item) const {
+		assert(ranked());
+		return m_score(m_pattern, item);
+	}
+	
 	bool defined() const
 	{
-		return m_filter.operator bool();
+		return m_filter || m_score;
+	}
+
+	bool ranked() const
+	{
+		return m_score.operator bool();
 	}
 
 private:
 	boost::regex m_rx;
 	FilterFunction m_filter;
+	FuzzyPattern m_pattern;
+	ScoreFunction m_score;
 };
 
 #endif // NCMPCPP_REGEX_FILTER_H
@@ -18,19 +18,28 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include "config.h"
+
 #include <array>
+#include <atomic>
 #include <boost/bind.hpp>
+#include <boost/locale/conversion.hpp>
+#include <boost/thread/future.hpp>
 #include <iomanip>
+#include <mutex>
+#include <sys/socket.h>
 
 #include "display.h"
 #include "global.h"
 #include "helpers.h"
+#include "library.h"
 #include "playlist.h"
 #include "search_engine.h"
 #include "settings.h"
 #include "status.h"
 #include "statusbar.h"
 #include "utility/comparators.h"
+#include "utility/worker_pool.h"
 #include "title.h"
 #include "screen_switcher.h"
 
@@ -70,9 +79,403 @@ namespace pos {
 
 std::string SEItemToString(const SEItem &ei);
 bool SEItemEntryMatcher(const boost::regex &rx, const NC::Menu<SEItem>::Item &item, bool filter);
+int SEItemEntryScore(const FuzzyPattern &pattern, const NC::Menu<SEItem>::Item &item);
+
+// tags searched by constraints (apart from the first one, which searches all of them)
+const MPD::Song::ViewFunction SearchedTags[] = {
+	&MPD::Song::viewArtist,
+	&MPD::Song::viewAlbumArtist,
+	&MPD::Song::viewTitle,
+	&MPD::Song::viewAlbum,
+	&MPD::Song::viewName,
+	&MPD::Song::viewComposer,
+	&MPD::Song::viewPerformer,
+	&MPD::Song::viewGenre,
+	&MPD::Song::viewDate,
+	&MPD::Song::viewComment
+};
+
+bool regexSearch(boost::string_ref s, const boost::regex &rx)
+{
+	return boost::regex_search(s.begin(), s.end(), rx);
+}
+
+// Calls the function for consecutive chunks of songs. Long lists are
+// split between workers of the pool, results are returned in order.
+template <typename FunctionT>
+auto processInChunks(WorkerPool &workers,
+                     std::vector<MPD::Song>::const_iterator begin,
+                     std::vector<MPD::Song>::const_iterator end,
+                     const FunctionT &f) -> std::vector<decltype(f(begin, end))>
+{
+	typedef decltype(f(begin, end)) Result;
+	// for shorter chunks handing them over costs more than it saves
+	const size_t min_chunk_size = 1024;
+	size_t size = end-begin;
+	size_t chunks = std::min<size_t>(workers.concurrency(), size/min_chunk_size);
+	chunks = std::max<size_t>(chunks, 1);
+	size_t chunk_size = size/chunks;
+	
+	std::vector<Result> results(chunks);
+	if (chunks == 1)
+		results[0] = f(begin, end);
+	else
+	{
+		workers.run(chunks, [&](size_t i) {
+			auto first = begin+i*chunk_size;
+			auto last = i+1 < chunks ? first+chunk_size : end;
+			results[i] = f(first, last);
+		});
+	}
+	return results;
+}
+
+// Returns songs that satisfy the predicate, in the original order.
+template <typename PredicateT>
+std::vector<MPD::Song> filterSongs(WorkerPool &workers,
+                                   std::vector<MPD::Song>::const_iterator begin,
+                                   std::vector<MPD::Song>::const_iterator end,
+                                   const PredicateT &pred)
+{
+	typedef std::vector<MPD::Song> Songs;
+	auto parts = processInChunks(workers, begin, end,
+		[&pred](Songs::const_iterator first, Songs::const_iterator last) {
+			Songs result;
+			for (; first != last; ++first)
+				if (pred(*first))
+					result.push_back(*first);
+			return result;
+	});
+	Songs result;
+	for (auto &part : parts)
+		std::move(part.begin(), part.end(), std::back_inserter(result));
+	return result;
+}
 
+// Returns at most limit songs with the highest score, the best one first.
+template <typename ScoreT>
+std::vector<MPD::Song> bestSongs(WorkerPool &workers,
+                                 const std::vector<MPD::Song> &songs,
+                                 size_t limit, const ScoreT &score)
+{
+	typedef std::vector<MPD::Song> Songs;
+	typedef std::pair<int, Songs::const_iterator> Match;
+	auto parts = processInChunks(workers, songs.begin(), songs.end(),
+		[limit, &score](Songs::const_iterator first, Songs::const_iterator last) {
+			return bestMatches(first, last, limit, score);
+	});
+	// best matches of each chunk are already known, so
+	// only the best of these are left to be selected.
+	std::vector<Match> matches;
+	for (auto &part : parts)
+		matches.insert(matches.end(), part.begin(), part.end());
+	auto middle = matches.begin() + std::min(limit, matches.size());
+	std::partial_sort(matches.begin(), middle, matches.end(),
+		[](const Match &a, const Match &b) {
+			return a.first > b.first || (a.first == b.first && a.second < b.second);
+	});
+	Songs result;
+	for (auto it = matches.begin(); it != middle; ++it)
+		result.push_back(*it->second);
+	return result;
+}
+
+bool containsIgnoreCase(boost::string_ref s, const std::string &phrase)
+{
+	auto is_ascii = [](char c) {
+		return static_cast<unsigned char>(c) < 0x80;
+	};
+	if (std::all_of(s.begin(), s.end(), is_ascii)
+	&&  std::all_of(phrase.begin(), phrase.end(), is_ascii))
+	{
+		return std::search(s.begin(), s.end(), phrase.begin(), phrase.end(),
+			[](char a, char b) {
+				return tolower(a) == tolower(b);
+		}) != s.end();
+	}
+	else
+		return boost::locale::fold_case(s.to_string()).find(boost::locale::fold_case(phrase)) != std::string::npos;
+}
+
+// Returns strings that every string matched by the regex has to contain.
+// The list doesn't have to be complete, unclear parts of the pattern and
+// groups are skipped. If the pattern has top level alternatives, nothing
+// is returned.
+std::vector<std::string> requiredLiterals(const std::string &pattern, boost::regex::flag_type flags)
+{
+	std::vector<std::string> result;
+	if (flags & boost::regex::literal)
+	{
+		result.push_back(pattern);
+		return result;
+	}
+	bool basic = flags & boost::regex::basic_syntax_group;
+	
+	std::string literal;
+	auto push_literal = [&result, &literal] {
+		if (!literal.empty())
+			result.push_back(std::move(literal));
+		literal.clear();
+	};
+	// makes the last character optional
+	auto drop_last = [&literal, &push_literal] {
+		if (!literal.empty())
+			literal.resize(literal.size()-1);
+		push_literal();
+	};
+	
+	size_t depth = 0;
+	for (size_t i = 0; i < pattern.size(); ++i)
+	{
+		char c = pattern[i];
+		if (c == '\\' && i+1 < pattern.size())
+		{
+			c = pattern[++i];
+			if (basic && (c == '(' || c == ')' || c == '{' || c == '|'))
+			{
+				if (c == '(')
+					++depth, push_literal();
+				else if (c == ')' && depth > 0)
+					--depth;
+				else if (c == '{')
+				{
+					drop_last();
+					size_t end = pattern.find("\\}", i);
+					i = end != std::string::npos ? end+1 : pattern.size();
+				}
+				else if (depth == 0)
+					return std::vector<std::string>();
+			}
+			else if (isalnum(static_cast<unsigned char>(c)))
+				push_literal(); // character class or back reference
+			else if (depth == 0)
+				literal += c;
+		}
+		else if (c == '[')
+		{
+			push_literal();
+			// skip the whole bracket expression
+			if (i+1 < pattern.size() && pattern[i+1] == '^')
+				++i;
+			if (i+1 < pattern.size() && pattern[i+1] == ']')
+				++i;
+			for (++i; i < pattern.size() && pattern[i] != ']'; ++i)
+			{
+				if (pattern[i] == '[' && i+1 < pattern.size()
+				&&  (pattern[i+1] == ':' || pattern[i+1] == '.' || pattern[i+1] == '='))
+				{
+					size_t end = pattern.find(std::string(1, pattern[i+1]) + "]", i+2);
+					if (end == std::string::npos)
+						break;
+					i = end+1;
+				}
+			}
+		}
+		else if (c == '.' || c == '^' || c == '$')
+			push_literal();
+		else if (c == '*')
+			drop_last();
+		else if (!basic && c == '?')
+			drop_last();
+		else if (!basic && c == '{')
+		{
+			drop_last();
+			i = std::min(pattern.find('}', i), pattern.size());
+		}
+		else if (!basic && c == '+')
+			push_literal();
+		else if (!basic && c == '(')
+			++depth, push_literal();
+		else if (!basic && c == ')')
+			depth -= depth > 0;
+		else if (!basic && c == '|' && depth == 0)
+			return std::vector<std::string>();
+		else if (depth == 0)
+			literal += c;
+	}
+	push_literal();
+	return result;
 }
 
+// Matches songs against constraints of the search engine. It's shared
+// by threads searching in the background, so it's immutable once built.
+struct SongMatcher
+{
+	enum class Mode { Contains, Regex, Exact };
+	
+	SongMatcher(const std::string *constraints, Mode mode)
+	: m_mode(mode), m_cmp(std::locale(), Config.ignore_leading_the)
+	{
+		// constraints that are not used (or are invalid regexes) are left empty
+		for (size_t i = 0; i < m_constraints.size(); ++i)
+		{
+			if (constraints[i].empty())
+				continue;
+			if (m_mode == Mode::Regex)
+			{
+				try
+				{
+					m_regexes[i].assign(constraints[i], Config.regex_type);
+				}
+				catch (boost::bad_expression &)
+				{
+					continue;
+				}
+			}
+			m_constraints[i] = constraints[i];
+		}
+	}
+	
+	bool operator()(const MPD::Song &s) const
+	{
+		if (!m_constraints[0].empty()
+		&&  std::none_of(std::begin(SearchedTags), std::end(SearchedTags),
+			[this, &s](MPD::Song::ViewFunction view) {
+				return matches((s.*view)(0), 0);
+		}))
+			return false;
+		for (size_t i = 1; i < m_constraints.size(); ++i)
+			if (!m_constraints[i].empty() && !matches((s.*SearchedTags[i-1])(0), i))
+				return false;
+		return true;
+	}
+	
+	// Returns strings that matching songs have to contain,
+	// so that the library index can narrow down candidates.
+	std::vector<std::string> requiredStrings() const
+	{
+		std::vector<std::string> result;
+		if (m_mode == Mode::Exact)
+			return result;
+		for (const auto &constraint : m_constraints)
+		{
+			if (constraint.empty())
+				continue;
+			if (m_mode == Mode::Contains)
+				result.push_back(constraint);
+			else
+			{
+				auto literals = requiredLiterals(constraint, Config.regex_type);
+				std::move(literals.begin(), literals.end(), std::back_inserter(result));
+			}
+		}
+		return result;
+	}
+	
+private:
+	bool matches(boost::string_ref tag, size_t i) const
+	{
+		switch (m_mode)
+		{
+			case Mode::Contains:
+				return containsIgnoreCase(tag, m_constraints[i]);
+			case Mode::Regex:
+				return regexSearch(tag, m_regexes[i]);
+			case Mode::Exact:
+				return m_cmp(tag, m_constraints[i]) == 0;
+		}
+		return false;
+	}
+	
+	Mode m_mode;
+	std::array<std::string, SearchEngine::ConstraintsNumber> m_constraints;
+	std::array<boost::regex, SearchEngine::ConstraintsNumber> m_regexes;
+	LocaleStringComparison m_cmp;
+};
+
+// Scores songs by approximate matching of constraints. The first
+// one is matched against artist, album and title of the song.
+struct SongScorer
+{
+	SongScorer(const std::string *constraints)
+	{
+		for (size_t i = 0; i < m_patterns.size(); ++i)
+			m_patterns[i] = FuzzyPattern(constraints[i]);
+	}
+	
+	int operator()(const MPD::Song &s) const
+	{
+		int result = 0;
+		if (!m_patterns[0].empty())
+			result = fuzzySongScore(m_patterns[0], s);
+		for (size_t i = 1; result >= 0 && i < m_patterns.size(); ++i)
+		{
+			if (!m_patterns[i].empty())
+			{
+				int score = m_patterns[i].score((s.*SearchedTags[i-1])(0));
+				result = score >= 0 ? result+score : -1;
+			}
+		}
+		return result;
+	}
+	
+private:
+	std::array<FuzzyPattern, SearchEngine::ConstraintsNumber> m_patterns;
+};
+
+// number of songs shown in fuzzy mode
+const size_t FuzzyResultsLimit = 500;
+
+// delay between the last change of a constraint and the live search
+const boost::posix_time::milliseconds LiveSearchDelay(150);
+// how often results and changes are checked while searching
+const int SearchPollTimeout = 50;
+
+}
+
+struct SearchEngine::SearchJob
+{
+	SearchJob()
+	: live(false), started(boost::posix_time::microsec_clock::local_time())
+	, cancelled(false), stopped(false), fd(-1), finished(false), complete(false) { }
+	
+	// runs the search, recording its errors
+	template <typename SearchT>
+	void run(SearchT search)
+	{
+		try
+		{
+			search();
+		}
+		catch (std::exception &e)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!cancelled)
+				error = e.what();
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		finished = true;
+	}
+	
+	// parameters the search was started with
+	std::array<std::string, ConstraintsNumber> constraints;
+	const char **mode;
+	bool in_db;
+	bool live;
+	
+	boost::posix_time::ptime started;
+	boost::posix_time::time_duration first_result;
+	
+	std::vector<MPD::Song> candidates;
+	boost::future<void> worker;
+	std::atomic<bool> cancelled;
+	// if search was cancelled by the user
+	bool stopped;
+	
+	// descriptor of the connection used for searching with mpd
+	std::mutex mutex;
+	int fd;
+	
+	// songs found by the worker, but not yet added to the menu
+	std::vector<MPD::Song> found;
+	std::string error;
+	bool finished;
+	
+	// all songs that were found
+	std::vector<MPD::Song> results;
+	bool complete;
+};
+
 const char *SearchEngine::ConstraintsNames[] =
 {
 	"Any",
@@ -93,6 +496,7 @@ const char *SearchEngine::SearchModes[] =
 	"Match if tag contains searched phrase (no regexes)",
 	"Match if tag contains searched phrase (regexes supported)",
 	"Match only if both values are the same",
+	"Match approximately, best matches first",
 	0
 };
 
@@ -110,6 +514,8 @@ SearchEngine::SearchEngine()
 	w.setSelectedPrefix(Config.selected_item_prefix);
 	w.setSelectedSuffix(Config.selected_item_suffix);
 	SearchMode = &SearchModes[Config.search_engine_default_search_mode];
+	m_workers = std::make_shared<WorkerPool>();
+	m_live_search_pending = false;
 }
 
 void SearchEngine::resize()
@@ -137,7 +543,7 @@ void SearchEngine::switchTo()
 	SwitchTo::execute(this);
 	if (w.empty())
 		Prepare();
-	markSongsInPlaylist(proxySongList());
+	markSongsInPlaylist();
 	drawHeader();
 }
 
@@ -146,6 +552,19 @@ std::wstring SearchEngine::title()
 	return L"Search engine";
 }
 
+void SearchEngine::update()
+{
+	collectResults();
+}
+
+int SearchEngine::windowTimeout()
+{
+	if (m_live_search_pending || isSearching())
+		return SearchPollTimeout;
+	else
+		return Screen<WindowType>::windowTimeout();
+}
+
 void SearchEngine::enterPressed()
 {
 	size_t option = w.choice();
@@ -157,7 +576,44 @@ void SearchEngine::enterPressed()
 		Statusbar::ScopedLock slock;
 		std::string constraint = ConstraintsNames[option];
 		Statusbar::put() << NC::Format::Bold << constraint << NC::Format::NoBold << ": ";
-		itsConstraints[option] = Global::wFooter->prompt(itsConstraints[option]);
+		if (Config.search_engine_search_as_you_type)
+		{
+			NC::Window::ScopedPromptHook helper(*Global::wFooter, [this, option](const char *s) {
+				Status::trace();
+				liveSearch(option, s);
+				return true;
+			});
+			std::string old_constraint = itsConstraints[option];
+			int old_timeout = Global::wFooter->getTimeout();
+			Global::wFooter->setTimeout(SearchPollTimeout);
+			try
+			{
+				itsConstraints[option] = Global::wFooter->prompt(itsConstraints[option]);
+			}
+			catch (NC::PromptAborted &)
+			{
+				Global::wFooter->setTimeout(old_timeout);
+				m_live_search_pending = false;
+				// results of what was typed are replaced with
+				// the ones of the constraint that is displayed
+				if (itsConstraints[option] != old_constraint)
+				{
+					itsConstraints[option] = old_constraint;
+					startSearch(true);
+					collectResults();
+				}
+				throw;
+			}
+			Global::wFooter->setTimeout(old_timeout);
+			if (m_live_search_pending)
+			{
+				m_live_search_pending = false;
+				startSearch(true);
+				collectResults();
+			}
+		}
+		else
+			itsConstraints[option] = Global::wFooter->prompt(itsConstraints[option]);
 		w.current()->value().buffer().clear();
 		constraint.resize(13, ' ');
 		w.current()->value().buffer() << NC::Format::Bold << constraint << NC::Format::NoBold << ": ";
@@ -177,29 +633,8 @@ void SearchEngine::enterPressed()
 	else if (option == SearchButton)
 	{
 		Statusbar::print("Searching...");
-		if (w.size() > StaticOptions)
-			Prepare();
-		Search();
-		if (w.rbegin()->value().isSong())
-		{
-			if (Config.search_engine_display_mode == DisplayMode::Columns)
-				w.setTitle(Config.titles_visibility ? Display::Columns(w.getWidth()) : "");
-			size_t found = w.size()-SearchEngine::StaticOptions;
-			found += 3; // don't count options inserted below
-			w.insertSeparator(ResetButton+1);
-			w.insertItem(ResetButton+2, SEItem(), 1, 1);
-			w.at(ResetButton+2).value().mkBuffer() << Config.color1 << "Search results: " << Config.color2 << "Found " << found << (found > 1 ? " songs" : " song") << NC::Color::Default;
-			w.insertSeparator(ResetButton+3);
-			markSongsInPlaylist(proxySongList());
-			Statusbar::print("Searching finished");
-			if (Config.block_search_constraints_change)
-				for (size_t i = 0; i < StaticOptions-4; ++i)
-					w.at(i).setInactive(true);
-			w.scroll(NC::Scroll::Down);
-			w.scroll(NC::Scroll::Down);
-		}
-		else
-			Statusbar::print("No results found");
+		startSearch(false);
+		collectResults();
 	}
 	else if (option == ResetButton)
 	{
@@ -262,10 +697,15 @@ bool SearchEngine::allowsSearching()
 
 void SearchEngine::setSearchConstraint(const std::string &constraint)
 {
-	m_search_predicate = RegexItemFilter<SEItem>(
-		boost::regex(constraint, Config.regex_type),
-		boost::bind(SEItemEntryMatcher, _1, _2, false)
-	);
+	if (Config.fuzzy_find)
+		m_search_predicate = RegexItemFilter<SEItem>(
+			FuzzyPattern(constraint), SEItemEntryScore
+		);
+	else
+		m_search_predicate = RegexItemFilter<SEItem>(
+			boost::regex(constraint, Config.regex_type),
+			boost::bind(SEItemEntryMatcher, _1, _2, false)
+		);
 }
 
 void SearchEngine::clearConstraint()
@@ -348,6 +788,8 @@ void SearchEngine::Prepare()
 
 void SearchEngine::reset()
 {
+	cancelSearch();
+	m_search_job.reset();
 	for (size_t i = 0; i < ConstraintsNumber; ++i)
 		itsConstraints[i].clear();
 	w.reset();
@@ -355,230 +797,302 @@ void SearchEngine::reset()
 	Statusbar::print("Search state reset");
 }
 
-void SearchEngine::Search()
+void SearchEngine::startSearch(bool live)
 {
-	bool constraints_empty = 1;
-	for (size_t i = 0; i < ConstraintsNumber; ++i)
+	cancelSearch();
+	
+	auto job = std::make_shared<SearchJob>();
+	std::copy(itsConstraints, itsConstraints+ConstraintsNumber, job->constraints.begin());
+	job->mode = SearchMode;
+	job->in_db = Config.search_in_db;
+	job->live = live;
+	
+	// if each constraint only got longer since the last completed search,
+	// matching songs are among its results. it's not true for regexes though.
+	bool narrow = m_search_job
+	           && m_search_job->complete
+	           && !m_search_job->cancelled
+	           && m_search_job->mode == job->mode
+	           && m_search_job->in_db == job->in_db
+	           && (job->mode == &SearchModes[0]
+	           ||  (job->mode == &SearchModes[1] && Config.regex_type & boost::regex::literal));
+	for (size_t i = 0; narrow && i < ConstraintsNumber; ++i)
+		narrow = job->constraints[i].find(m_search_job->constraints[i]) != std::string::npos;
+	if (narrow)
+		job->candidates = std::move(m_search_job->results);
+	m_search_job = job;
+	
+	Prepare();
+	if (std::all_of(job->constraints.begin(), job->constraints.end(),
+		[](const std::string &c) { return c.empty(); }))
+	{
+		m_search_job.reset();
+		return;
+	}
+	w.addSeparator();
+	w.addItem(SEItem(), true, true);
+	w.rbegin()->value().mkBuffer() << Config.color1 << "Search results: " << Config.color2 << "Searching..." << NC::Color::Default;
+	w.addSeparator();
+	
+	if (job->in_db && job->mode == &SearchModes[2]) // use built-in mpd searching
+	{
+		// main connection can't be used by the worker, so it opens a separate one.
+		// it also makes it possible to cancel a search the server is busy with.
+		std::string host = Mpd.GetHostname(), password = Mpd.GetPassword();
+		int port = Mpd.GetPort(), timeout = Mpd.GetTimeout();
+		job->worker = boost::async(boost::launch::async, [job, host, port, timeout, password] {
+			MPD::Connection mpd;
+			job->run([&] {
+				mpd.SetHostname(host);
+				mpd.SetPort(port);
+				mpd.SetTimeout(timeout);
+				mpd.SetPassword(password);
+				mpd.Connect();
+				{
+					std::lock_guard<std::mutex> lock(job->mutex);
+					if (job->cancelled)
+						return;
+					job->fd = mpd.GetFD();
+				}
+				const auto &c = job->constraints;
+				mpd.StartSearch(true);
+				if (!c[0].empty())
+					mpd.AddSearchAny(c[0]);
+				if (!c[1].empty())
+					mpd.AddSearch(MPD_TAG_ARTIST, c[1]);
+				if (!c[2].empty())
+					mpd.AddSearch(MPD_TAG_ALBUM_ARTIST, c[2]);
+				if (!c[3].empty())
+					mpd.AddSearch(MPD_TAG_TITLE, c[3]);
+				if (!c[4].empty())
+					mpd.AddSearch(MPD_TAG_ALBUM, c[4]);
+				if (!c[5].empty())
+					mpd.AddSearchURI(c[5]);
+				if (!c[6].empty())
+					mpd.AddSearch(MPD_TAG_COMPOSER, c[6]);
+				if (!c[7].empty())
+					mpd.AddSearch(MPD_TAG_PERFORMER, c[7]);
+				if (!c[8].empty())
+					mpd.AddSearch(MPD_TAG_GENRE, c[8]);
+				if (!c[9].empty())
+					mpd.AddSearch(MPD_TAG_DATE, c[9]);
+				if (!c[10].empty())
+					mpd.AddSearch(MPD_TAG_COMMENT, c[10]);
+				// songs are handed over as they arrive, so
+				// that the first ones can be displayed early.
+				for (auto s = mpd.CommitSearchSongs(), end = MPD::SongIterator(); s != end && !job->cancelled; ++s)
+				{
+					std::lock_guard<std::mutex> lock(job->mutex);
+					job->found.push_back(std::move(*s));
+				}
+			});
+			// the connection is closed only after the
+			// descriptor can't be used for cancelling.
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->fd = -1;
+		});
+		return;
+	}
+	
+	if (job->mode == &SearchModes[3])
 	{
-		if (!itsConstraints[i].empty())
+		if (job->in_db)
+			job->candidates = Library::songs();
+		else
+			std::copy(
+				myPlaylist->main().beginV(),
+				myPlaylist->main().endV(),
+				std::back_inserter(job->candidates)
+			);
+		// all songs have to be scored before the best ones are known,
+		// so they are handed over at once.
+		auto scorer = std::make_shared<SongScorer>(itsConstraints);
+		auto workers = m_workers;
+		job->worker = boost::async(boost::launch::async, [job, scorer, workers] {
+			job->run([&] {
+				auto found = bestSongs(*workers, job->candidates, FuzzyResultsLimit,
+					[&job, &scorer](const MPD::Song &s) {
+						return job->cancelled ? -1 : (*scorer)(s);
+				});
+				std::lock_guard<std::mutex> lock(job->mutex);
+				job->found = std::move(found);
+			});
+		});
+		return;
+	}
+	
+	auto matcher = std::make_shared<SongMatcher>(
+		itsConstraints, SongMatcher::Mode(job->mode - SearchModes)
+	);
+	if (!narrow)
+	{
+		if (job->in_db)
 		{
-			constraints_empty = 0;
-			break;
+			const auto &library = Library::songs();
+			for (auto i : Library::candidates(matcher->requiredStrings()))
+				job->candidates.push_back(library[i]);
+		}
+		else
+		{
+			std::copy(
+				myPlaylist->main().beginV(),
+				myPlaylist->main().endV(),
+				std::back_inserter(job->candidates)
+			);
 		}
 	}
-	if (constraints_empty)
-		return;
 	
-	if (Config.search_in_db && (SearchMode == &SearchModes[0] || SearchMode == &SearchModes[2])) // use built-in mpd searching
-	{
-		Mpd.StartSearch(SearchMode == &SearchModes[2]);
-		if (!itsConstraints[0].empty())
-			Mpd.AddSearchAny(itsConstraints[0]);
-		if (!itsConstraints[1].empty())
-			Mpd.AddSearch(MPD_TAG_ARTIST, itsConstraints[1]);
-		if (!itsConstraints[2].empty())
-			Mpd.AddSearch(MPD_TAG_ALBUM_ARTIST, itsConstraints[2]);
-		if (!itsConstraints[3].empty())
-			Mpd.AddSearch(MPD_TAG_TITLE, itsConstraints[3]);
-		if (!itsConstraints[4].empty())
-			Mpd.AddSearch(MPD_TAG_ALBUM, itsConstraints[4]);
-		if (!itsConstraints[5].empty())
-			Mpd.AddSearchURI(itsConstraints[5]);
-		if (!itsConstraints[6].empty())
-			Mpd.AddSearch(MPD_TAG_COMPOSER, itsConstraints[6]);
-		if (!itsConstraints[7].empty())
-			Mpd.AddSearch(MPD_TAG_PERFORMER, itsConstraints[7]);
-		if (!itsConstraints[8].empty())
-			Mpd.AddSearch(MPD_TAG_GENRE, itsConstraints[8]);
-		if (!itsConstraints[9].empty())
-			Mpd.AddSearch(MPD_TAG_DATE, itsConstraints[9]);
-		if (!itsConstraints[10].empty())
-			Mpd.AddSearch(MPD_TAG_COMMENT, itsConstraints[10]);
-		for (MPD::SongIterator s = Mpd.CommitSearchSongs(), end; s != end; ++s)
-			w.addItem(std::move(*s));
+	// the worker shares state only with the job, so that it can be
+	// left running even if the search engine starts another search.
+	auto workers = m_workers;
+	job->worker = boost::async(boost::launch::async, [job, matcher, workers] {
+		job->run([&] {
+			// songs are matched in blocks, so that found ones can be displayed
+			// and the search cancelled without waiting for the whole list.
+			const size_t block_size = workers->concurrency() * 4096;
+			const auto &candidates = job->candidates;
+			for (auto first = candidates.cbegin(); first != candidates.cend() && !job->cancelled;)
+			{
+				auto last = first + std::min<size_t>(block_size, candidates.cend()-first);
+				auto found = filterSongs(*workers, first, last, *matcher);
+				first = last;
+				std::lock_guard<std::mutex> lock(job->mutex);
+				std::move(found.begin(), found.end(), std::back_inserter(job->found));
+			}
+		});
+	});
+}
+
+void SearchEngine::cancelSearch()
+{
+	if (!m_search_job || m_search_job->complete)
 		return;
+	{
+		std::lock_guard<std::mutex> lock(m_search_job->mutex);
+		m_search_job->cancelled = true;
+		// interrupt waiting for the server
+		if (m_search_job->fd >= 0)
+			shutdown(m_search_job->fd, SHUT_RDWR);
 	}
+	if (m_search_job->worker.valid())
+		m_search_job->worker.wait();
+}
+
+void SearchEngine::collectResults()
+{
+	if (!m_search_job || m_search_job->complete
+	||  (m_search_job->cancelled && !m_search_job->stopped))
+		return;
+	auto &job = *m_search_job;
 	
-	std::vector<MPD::Song> list;
-	if (Config.search_in_db)
+	std::vector<MPD::Song> found;
+	bool finished;
+	std::string error;
 	{
-		std::copy(
-			std::make_move_iterator(Mpd.GetDirectoryRecursive("/")),
-			std::make_move_iterator(MPD::SongIterator()),
-			std::back_inserter(list)
-		);
+		std::lock_guard<std::mutex> lock(job.mutex);
+		found.swap(job.found);
+		finished = job.finished;
+		error.swap(job.error);
 	}
-	else
+	if (found.empty() && !finished)
+		return;
+	
+	if (w.size() == StaticOptions && !found.empty())
 	{
-		std::copy(
-			myPlaylist->main().beginV(),
-			myPlaylist->main().endV(),
-			std::back_inserter(list)
-		);
+		job.first_result = boost::posix_time::microsec_clock::local_time() - job.started;
+		if (Config.search_engine_display_mode == DisplayMode::Columns)
+			w.setTitle(Config.titles_visibility ? Display::Columns(w.getWidth()) : "");
+	}
+	if (!found.empty())
+		m_playlist_marker.invalidate();
+	for (auto &s : found)
+	{
+		w.addItem(s);
+		job.results.push_back(std::move(s));
 	}
 	
-	bool any_found = 1;
-	bool found = 1;
+	size_t count = w.size()-StaticOptions;
+	if (w.size() >= StaticOptions)
+	{
+		auto &header = w.at(ResetButton+2).value().mkBuffer();
+		header << Config.color1 << "Search results: " << Config.color2 << "Found " << count << (count == 1 ? " song" : " songs");
+		if (!finished)
+			header << "...";
+		header << NC::Color::Default;
+	}
 	
-	LocaleStringComparison cmp(std::locale(), Config.ignore_leading_the);
-	for (auto it = list.begin(); it != list.end(); ++it)
+	if (finished)
 	{
-		if (SearchMode != &SearchModes[2]) // match to pattern
+		job.complete = true;
+		if (!error.empty())
+			Statusbar::printf("Search failed: %1%", error);
+		else if (count == 0)
 		{
-			boost::regex rx;
-			if (!itsConstraints[0].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[0], Config.regex_type);
-					any_found =
-					   boost::regex_search(it->getArtist(), rx)
-					|| boost::regex_search(it->getAlbumArtist(), rx)
-					|| boost::regex_search(it->getTitle(), rx)
-					|| boost::regex_search(it->getAlbum(), rx)
-					|| boost::regex_search(it->getName(), rx)
-					|| boost::regex_search(it->getComposer(), rx)
-					|| boost::regex_search(it->getPerformer(), rx)
-					|| boost::regex_search(it->getGenre(), rx)
-					|| boost::regex_search(it->getDate(), rx)
-					|| boost::regex_search(it->getComment(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			
-			if (found && !itsConstraints[1].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[1], Config.regex_type);
-					found = boost::regex_search(it->getArtist(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[2].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[2], Config.regex_type);
-					found = boost::regex_search(it->getAlbumArtist(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[3].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[3], Config.regex_type);
-					found = boost::regex_search(it->getTitle(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[4].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[4], Config.regex_type);
-					found = boost::regex_search(it->getAlbum(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[5].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[5], Config.regex_type);
-					found = boost::regex_search(it->getName(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[6].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[6], Config.regex_type);
-					found = boost::regex_search(it->getComposer(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[7].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[7], Config.regex_type);
-					found = boost::regex_search(it->getPerformer(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && itsConstraints[8].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[8], Config.regex_type);
-					found = boost::regex_search(it->getGenre(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[9].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[9], Config.regex_type);
-					found = boost::regex_search(it->getDate(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
-			if (found && !itsConstraints[10].empty())
-			{
-				try
-				{
-					rx.assign(itsConstraints[10], Config.regex_type);
-					found = boost::regex_search(it->getComment(), rx);
-				}
-				catch (boost::bad_expression &) { }
-			}
+			// remove the header
+			w.resizeList(StaticOptions-3);
+			if (job.stopped)
+				Statusbar::print("Searching cancelled");
+			else if (!job.live)
+				Statusbar::print("No results found");
 		}
-		else // match only if values are equal
+		else
 		{
-			if (!itsConstraints[0].empty())
-				any_found =
-				   !cmp(it->getArtist(), itsConstraints[0])
-				|| !cmp(it->getAlbumArtist(), itsConstraints[0])
-				|| !cmp(it->getTitle(), itsConstraints[0])
-				|| !cmp(it->getAlbum(), itsConstraints[0])
-				|| !cmp(it->getName(), itsConstraints[0])
-				|| !cmp(it->getComposer(), itsConstraints[0])
-				|| !cmp(it->getPerformer(), itsConstraints[0])
-				|| !cmp(it->getGenre(), itsConstraints[0])
-				|| !cmp(it->getDate(), itsConstraints[0])
-				|| !cmp(it->getComment(), itsConstraints[0]);
-			
-			if (found && !itsConstraints[1].empty())
-				found = !cmp(it->getArtist(), itsConstraints[1]);
-			if (found && !itsConstraints[2].empty())
-				found = !cmp(it->getAlbumArtist(), itsConstraints[2]);
-			if (found && !itsConstraints[3].empty())
-				found = !cmp(it->getTitle(), itsConstraints[3]);
-			if (found && !itsConstraints[4].empty())
-				found = !cmp(it->getAlbum(), itsConstraints[4]);
-			if (found && !itsConstraints[5].empty())
-				found = !cmp(it->getName(), itsConstraints[5]);
-			if (found && !itsConstraints[6].empty())
-				found = !cmp(it->getComposer(), itsConstraints[6]);
-			if (found && !itsConstraints[7].empty())
-				found = !cmp(it->getPerformer(), itsConstraints[7]);
-			if (found && !itsConstraints[8].empty())
-				found = !cmp(it->getGenre(), itsConstraints[8]);
-			if (found && !itsConstraints[9].empty())
-				found = !cmp(it->getDate(), itsConstraints[9]);
-			if (found && !itsConstraints[10].empty())
-				found = !cmp(it->getComment(), itsConstraints[10]);
+			markSongsInPlaylist();
+			if (job.stopped)
+				Statusbar::print("Searching cancelled");
+			else if (!job.live)
+			{
+				Statusbar::printf("Searching finished, first results after %1%ms",
+					job.first_result.total_milliseconds()
+				);
+				if (Config.block_search_constraints_change)
+					for (size_t i = 0; i < StaticOptions-4; ++i)
+						w.at(i).setInactive(true);
+				w.scroll(NC::Scroll::Down);
+				w.scroll(NC::Scroll::Down);
+			}
 		}
-		
-		if (found && any_found)
-			w.addItem(*it);
-		found = 1;
-		any_found = 1;
 	}
+	if (isVisible(this))
+		w.refresh();
+}
+
+void SearchEngine::markSongsInPlaylist()
+{
+	m_playlist_marker.mark(proxySongList());
+}
+
+bool SearchEngine::isSearching() const
+{
+	return m_search_job && !m_search_job->complete && !m_search_job->cancelled;
+}
+
+void SearchEngine::stopSearching()
+{
+	if (!isSearching())
+		return;
+	cancelSearch();
+	m_search_job->stopped = true;
+	collectResults();
+}
+
+void SearchEngine::liveSearch(size_t option, const char *constraint)
+{
+	auto now = boost::posix_time::microsec_clock::local_time();
+	if (itsConstraints[option] != constraint)
+	{
+		// results of the previous constraint are no longer relevant
+		cancelSearch();
+		itsConstraints[option] = constraint;
+		m_live_search_pending = true;
+		m_live_search_changed = now;
+	}
+	else if (m_live_search_pending && now - m_live_search_changed >= LiveSearchDelay)
+	{
+		m_live_search_pending = false;
+		startSearch(true);
+	}
+	collectResults();
 }
 
 namespace {
@@ -610,4 +1124,11 @@ bool SEItemEntryMatcher(const boost::regex &rx, const NC::Menu<SEItem>::Item &it
 	return boost::regex_search(SEItemToString(item.value()), rx);
 }
 
+int SEItemEntryScore(const FuzzyPattern &pattern, const NC::Menu<SEItem>::Item &item)
+{
+	if (item.isSeparator() || !item.value().isSong())
+		return -1;
+	return fuzzySongScore(pattern, item.value().song());
+}
+
 }
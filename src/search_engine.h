@@ -22,12 +22,16 @@
 #define NCMPCPP_SEARCH_ENGINE_H
 
 #include <cassert>
+#include <memory>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "interfaces.h"
 #include "mpdpp.h"
 #include "regex_filter.h"
 #include "screen.h"
 
+struct WorkerPool;
+
 struct SEItem
 {
 	SEItem() : m_is_song(false), m_buffer(0) { }
@@ -85,7 +89,9 @@ struct SearchEngine: Screen<NC::Menu<SEItem>>, HasSongs, Searchable, Tabbable
 	virtual std::wstring title() OVERRIDE;
 	virtual ScreenType type() OVERRIDE { return ScreenType::SearchEngine; }
 	
-	virtual void update() OVERRIDE { }
+	virtual void update() OVERRIDE;
+	
+	virtual int windowTimeout() OVERRIDE;
 	
 	virtual void enterPressed() OVERRIDE;
 	virtual void spacePressed() OVERRIDE;
@@ -109,16 +115,30 @@ struct SearchEngine: Screen<NC::Menu<SEItem>>, HasSongs, Searchable, Tabbable
 	// private members
 	void reset();
 	
+	bool isSearching() const;
+	void stopSearching();
+	
+	void markSongsInPlaylist();
+	
 	static size_t StaticOptions;
 	static size_t SearchButton;
 	static size_t ResetButton;
 	
+	static const size_t ConstraintsNumber = 11;
+	
 protected:
 	virtual bool isLockable() OVERRIDE { return true; }
 	
 private:
+	struct SearchJob;
+	
 	void Prepare();
-	void Search();
+	
+	// searching in the background
+	void startSearch(bool live);
+	void cancelSearch();
+	void collectResults();
+	void liveSearch(size_t option, const char *constraint);
 
 	RegexItemFilter<SEItem> m_search_predicate;
 	
@@ -126,10 +146,17 @@ private:
 	
 	static const char *SearchModes[];
 	
-	static const size_t ConstraintsNumber = 11;
 	static const char *ConstraintsNames[];
 	std::string itsConstraints[ConstraintsNumber];
 	
+	SongsInPlaylistMarker m_playlist_marker;
+	
+	std::shared_ptr<SearchJob> m_search_job;
+	// threads that match songs, shared with running searches
+	std::shared_ptr<WorkerPool> m_workers;
+	bool m_live_search_pending;
+	boost::posix_time::ptime m_live_search_changed;
+	
 	static bool MatchToPattern;
 };
 
@@ -206,7 +206,7 @@ void SelectedItemsAdder::populatePlaylistSelector(BaseScreen *old_screen)
 				boost::bind(&Self::addToExistingPlaylist, this, it->path())
 			));
 		};
-		std::sort(m_playlist_selector.beginV()+begin, m_playlist_selector.endV(),
+		sortByKeys(m_playlist_selector.beginV()+begin, m_playlist_selector.endV(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		if (begin < m_playlist_selector.size())
 			m_playlist_selector.addSeparator();
@@ -270,7 +270,10 @@ void SelectedItemsAdder::addAfterCurrentAlbum() const
 	if (Status::State::player() == MPD::psStop)
 		return;
 	auto &pl = myPlaylist->main();
-	size_t pos = Status::State::currentSongPosition();
+	int current = myPlaylist->songPosition(Status::State::currentSongID());
+	if (current < 0)
+		return;
+	size_t pos = current;
 	std::string album =  pl[pos].value().getAlbum();
 	while (pos < pl.size() && pl[pos].value().getAlbum() == album)
 		++pos;
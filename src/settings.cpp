@@ -347,6 +347,9 @@ bool Configuration::read(const std::vector<std::string> &config_paths)
 		browser_sort_format, "{%a - }{%t}|{%f} {(%l)}", [](std::string v) {
 			return Format::parse(v, Format::Flags::Tag);
 	}));
+	p.add("parallel_sort_threshold", assign_default(
+		parallel_sort_threshold, 10000
+	));
 	p.add("song_window_title_format", assign_default<std::string>(
 		song_window_title_format, "{%a - }{%t}|{%f}", [](std::string v) {
 			return Format::parse(v, Format::Flags::Tag);
@@ -453,6 +456,9 @@ bool Configuration::read(const std::vector<std::string> &config_paths)
 			throw std::runtime_error("invalid argument: " + v);
 	}, defaults_to(wrapped_search, true)
 	));
+	p.add("fuzzy_find", yes_no(
+		fuzzy_find, false
+	));
 	p.add("default_space_mode", option_parser::worker([this](std::string v) {
 		if (v == "add")
 			space_selects = false;
@@ -608,9 +614,12 @@ bool Configuration::read(const std::vector<std::string> &config_paths)
 	));
 	p.add("search_engine_default_search_mode", assign_default<unsigned>(
 		search_engine_default_search_mode, 1, [](unsigned v) {
-			boundsCheck(v, 1u, 3u);
+			boundsCheck(v, 1u, 4u);
 			return --v;
 	}));
+	p.add("search_engine_search_as_you_type", yes_no(
+		search_engine_search_as_you_type, false
+	));
 	p.add("external_editor", assign_default(
 		external_editor, "nano"
 	));
@@ -136,6 +136,7 @@ struct Configuration
 	bool screen_switcher_previous;
 	bool autocenter_mode;
 	bool wrapped_search;
+	bool fuzzy_find;
 	bool space_selects;
 	bool incremental_seeking;
 	bool now_playing_lyrics;
@@ -172,7 +173,9 @@ struct Configuration
 	unsigned message_delay_time;
 	unsigned lyrics_db;
 	unsigned lines_scrolled;
+	unsigned parallel_sort_threshold;
 	unsigned search_engine_default_search_mode;
+	bool search_engine_search_as_you_type;
 
 	boost::regex::flag_type regex_type;
 
@@ -21,9 +21,12 @@
 #include <cassert>
 #include <cstring>
 #include <boost/format.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/lexical_cast.hpp>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "song.h"
 #include "utility/type_conversions.h"
@@ -40,6 +43,37 @@ size_t calc_hash(const char* s, unsigned seed = 0)
 	return hash;
 }
 
+struct StringRefHash
+{
+	size_t operator()(boost::string_ref s) const {
+		return boost::hash_range(s.begin(), s.end());
+	}
+};
+
+// Pool of interned tag values, keyed by references to the values it owns,
+// so that looking them up doesn't need a copy. Values are never removed
+// from it, so pointers to them stay valid and can be read without locking.
+// Songs may be created by worker threads, so accessing it is synchronized.
+std::mutex tag_pool_mutex;
+std::unordered_map<
+	boost::string_ref,
+	std::unique_ptr<const std::string>,
+	StringRefHash
+> tag_pool;
+
+// needs tag_pool_mutex to be locked
+const std::string *internLocked(boost::string_ref value)
+{
+	auto it = tag_pool.find(value);
+	if (it == tag_pool.end())
+	{
+		std::unique_ptr<const std::string> s(new std::string(value.data(), value.size()));
+		boost::string_ref key(*s);
+		it = tag_pool.insert(std::make_pair(key, std::move(s))).first;
+	}
+	return it->second.get();
+}
+
 }
 
 namespace MPD {
@@ -49,36 +83,91 @@ std::string Song::TagsSeparator = " | ";
 std::string Song::get(mpd_tag_type type, unsigned idx) const
 {
 	std::string result;
-	const char *tag = mpd_song_get_tag(m_song.get(), type, idx);
+	const std::string *tag = getInterned(type, idx);
 	if (tag)
-		result = tag;
+		result = *tag;
 	return result;
 }
 
+const std::string *Song::getInterned(mpd_tag_type type, unsigned idx) const
+{
+	for (auto it = m_data->tags.begin(); it != m_data->tags.end(); ++it)
+	{
+		if (it->type == type)
+		{
+			if (idx == 0)
+				return it->value;
+			--idx;
+		}
+	}
+	return nullptr;
+}
+
 Song::Song(mpd_song *s)
 {
 	assert(s);
-	m_song = std::shared_ptr<mpd_song>(s, mpd_song_free);
-	m_hash = calc_hash(mpd_song_get_uri(s));
+	auto data = std::make_shared<Data>();
+	data->uri = mpd_song_get_uri(s);
+	data->duration = mpd_song_get_duration(s);
+	data->position = mpd_song_get_pos(s);
+	data->id = mpd_song_get_id(s);
+	data->prio = mpd_song_get_prio(s);
+	data->mtime = mpd_song_get_last_modified(s);
+	{
+		std::lock_guard<std::mutex> lock(tag_pool_mutex);
+		for (int type = 0; type < MPD_TAG_COUNT; ++type)
+		{
+			Tag tag;
+			tag.type = mpd_tag_type(type);
+			for (unsigned idx = 0; const char *value = mpd_song_get_tag(s, tag.type, idx); ++idx)
+			{
+				tag.value = internLocked(value);
+				data->tags.push_back(tag);
+			}
+		}
+	}
+	data->tags.shrink_to_fit();
+	mpd_song_free(s);
+	m_data = std::move(data);
+	m_hash = calc_hash(m_data->uri.c_str());
+}
+
+Song::Song(std::string uri, std::vector<Tag> tags, unsigned duration, time_t mtime)
+{
+	auto data = std::make_shared<Data>();
+	data->uri = std::move(uri);
+	data->tags = std::move(tags);
+	data->duration = duration;
+	data->position = 0;
+	data->id = 0;
+	data->prio = 0;
+	data->mtime = mtime;
+	m_data = std::move(data);
+	m_hash = calc_hash(m_data->uri.c_str());
+}
+
+const std::string *Song::intern(boost::string_ref value)
+{
+	std::lock_guard<std::mutex> lock(tag_pool_mutex);
+	return internLocked(value);
 }
 
 std::string Song::getURI(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	if (idx > 0)
 		return "";
 	else
-		return mpd_song_get_uri(m_song.get());
+		return m_data->uri;
 }
 
 std::string Song::getName(unsigned idx) const
 {
-	assert(m_song);
-	mpd_song *s = m_song.get();
-	const char *res = mpd_song_get_tag(s, MPD_TAG_NAME, idx);
+	assert(m_data);
+	const std::string *res = getInterned(MPD_TAG_NAME, idx);
 	if (!res && idx > 0)
 		return "";
-	const char *uri = mpd_song_get_uri(s);
+	const char *uri = m_data->uri.c_str();
 	const char *name = strrchr(uri, '/');
 	if (name)
 		return name+1;
@@ -88,10 +177,10 @@ std::string Song::getName(unsigned idx) const
 
 std::string Song::getDirectory(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	if (idx > 0 || isStream())
 		return "";
-	const char *uri = mpd_song_get_uri(m_song.get());
+	const char *uri = m_data->uri.c_str();
 	const char *name = strrchr(uri, '/');
 	if (name)
 		return std::string(uri, name-uri);
@@ -101,31 +190,31 @@ std::string Song::getDirectory(unsigned idx) const
 
 std::string Song::getArtist(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_ARTIST, idx);
 }
 
 std::string Song::getTitle(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_TITLE, idx);
 }
 
 std::string Song::getAlbum(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_ALBUM, idx);
 }
 
 std::string Song::getAlbumArtist(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_ALBUM_ARTIST, idx);
 }
 
 std::string Song::getTrack(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	std::string track = get(MPD_TAG_TRACK, idx);
 	if ((track.length() == 1 && track[0] != '0')
 	||  (track.length() > 3  && track[1] == '/'))
@@ -135,7 +224,7 @@ std::string Song::getTrack(unsigned idx) const
 
 std::string Song::getTrackNumber(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	std::string track = getTrack(idx);
 	size_t slash = track.find('/');
 	if (slash != std::string::npos)
@@ -145,43 +234,43 @@ std::string Song::getTrackNumber(unsigned idx) const
 
 std::string Song::getDate(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_DATE, idx);
 }
 
 std::string Song::getGenre(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_GENRE, idx);
 }
 
 std::string Song::getComposer(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_COMPOSER, idx);
 }
 
 std::string Song::getPerformer(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_PERFORMER, idx);
 }
 
 std::string Song::getDisc(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_DISC, idx);
 }
 
 std::string Song::getComment(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	return get(MPD_TAG_COMMENT, idx);
 }
 
 std::string Song::getLength(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	if (idx > 0)
 		return "";
 	unsigned len = getDuration();
@@ -193,7 +282,7 @@ std::string Song::getLength(unsigned idx) const
 
 std::string Song::getPriority(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_data);
 	if (idx > 0)
 		return "";
 	return boost::lexical_cast<std::string>(getPrio());
@@ -201,7 +290,7 @@ std::string Song::getPriority(unsigned idx) const
 
 std::string MPD::Song::getTags(GetFunction f) const
 {
-	assert(m_song);
+	assert(m_data);
 	unsigned idx = 0;
 	std::string result;
 	for (std::string tag; !(tag = (this->*f)(idx)).empty(); ++idx)
@@ -213,52 +302,208 @@ std::string MPD::Song::getTags(GetFunction f) const
 	return result;
 }
 
+boost::string_ref Song::viewTag(mpd_tag_type type, unsigned idx) const
+{
+	boost::string_ref result;
+	const std::string *tag = getInterned(type, idx);
+	if (tag)
+		result = *tag;
+	return result;
+}
+
+boost::string_ref Song::viewURI(unsigned idx) const
+{
+	assert(m_data);
+	if (idx > 0)
+		return boost::string_ref();
+	else
+		return m_data->uri;
+}
+
+boost::string_ref Song::viewName(unsigned idx) const
+{
+	assert(m_data);
+	const std::string *res = getInterned(MPD_TAG_NAME, idx);
+	if (!res && idx > 0)
+		return boost::string_ref();
+	boost::string_ref uri = m_data->uri;
+	size_t slash = uri.rfind('/');
+	if (slash != boost::string_ref::npos)
+		uri.remove_prefix(slash+1);
+	return uri;
+}
+
+boost::string_ref Song::viewDirectory(unsigned idx) const
+{
+	assert(m_data);
+	if (idx > 0 || isStream())
+		return boost::string_ref();
+	boost::string_ref uri = m_data->uri;
+	size_t slash = uri.rfind('/');
+	if (slash != boost::string_ref::npos)
+		return uri.substr(0, slash);
+	else
+		return "/";
+}
+
+boost::string_ref Song::viewArtist(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_ARTIST, idx);
+}
+
+boost::string_ref Song::viewTitle(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_TITLE, idx);
+}
+
+boost::string_ref Song::viewAlbum(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_ALBUM, idx);
+}
+
+boost::string_ref Song::viewAlbumArtist(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_ALBUM_ARTIST, idx);
+}
+
+boost::string_ref Song::viewDate(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_DATE, idx);
+}
+
+boost::string_ref Song::viewGenre(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_GENRE, idx);
+}
+
+boost::string_ref Song::viewComposer(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_COMPOSER, idx);
+}
+
+boost::string_ref Song::viewPerformer(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_PERFORMER, idx);
+}
+
+boost::string_ref Song::viewDisc(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_DISC, idx);
+}
+
+boost::string_ref Song::viewComment(unsigned idx) const
+{
+	assert(m_data);
+	return viewTag(MPD_TAG_COMMENT, idx);
+}
+
+boost::string_ref Song::viewTags(ViewFunction f, std::string &buffer) const
+{
+	assert(m_data);
+	boost::string_ref first = (this->*f)(0);
+	if (first.empty())
+		return first;
+	boost::string_ref tag = (this->*f)(1);
+	if (tag.empty())
+		return first;
+	buffer.assign(first.data(), first.size());
+	for (unsigned idx = 2; !tag.empty(); tag = (this->*f)(idx++))
+	{
+		buffer += TagsSeparator;
+		buffer.append(tag.data(), tag.size());
+	}
+	return buffer;
+}
+
+Song::ViewFunction Song::toViewFunction(GetFunction f)
+{
+	static const std::pair<GetFunction, ViewFunction> functions[] = {
+		{ &Song::getURI, &Song::viewURI },
+		{ &Song::getName, &Song::viewName },
+		{ &Song::getDirectory, &Song::viewDirectory },
+		{ &Song::getArtist, &Song::viewArtist },
+		{ &Song::getTitle, &Song::viewTitle },
+		{ &Song::getAlbum, &Song::viewAlbum },
+		{ &Song::getAlbumArtist, &Song::viewAlbumArtist },
+		{ &Song::getDate, &Song::viewDate },
+		{ &Song::getGenre, &Song::viewGenre },
+		{ &Song::getComposer, &Song::viewComposer },
+		{ &Song::getPerformer, &Song::viewPerformer },
+		{ &Song::getDisc, &Song::viewDisc },
+		{ &Song::getComment, &Song::viewComment },
+	};
+	for (auto it = std::begin(functions); it != std::end(functions); ++it)
+		if (it->first == f)
+			return it->second;
+	return nullptr;
+}
+
 unsigned Song::getDuration() const
 {
-	assert(m_song);
-	return mpd_song_get_duration(m_song.get());
+	assert(m_data);
+	return m_data->duration;
 }
 
 unsigned Song::getPosition() const
 {
-	assert(m_song);
-	return mpd_song_get_pos(m_song.get());
+	assert(m_data);
+	return m_data->position;
+}
+
+void Song::setPosition(unsigned position)
+{
+	assert(m_data);
+	if (m_data->position != position)
+	{
+		auto data = std::make_shared<Data>(*m_data);
+		data->position = position;
+		m_data = std::move(data);
+	}
 }
 
 unsigned Song::getID() const
 {
-	assert(m_song);
-	return mpd_song_get_id(m_song.get());
+	assert(m_data);
+	return m_data->id;
 }
 
 unsigned Song::getPrio() const
 {
-	assert(m_song);
-	return mpd_song_get_prio(m_song.get());
+	assert(m_data);
+	return m_data->prio;
 }
 
 time_t Song::getMTime() const
 {
-	assert(m_song);
-	return mpd_song_get_last_modified(m_song.get());
+	assert(m_data);
+	return m_data->mtime;
 }
 
 bool Song::isFromDatabase() const
 {
-	assert(m_song);
-	const char *uri = mpd_song_get_uri(m_song.get());
+	assert(m_data);
+	const char *uri = m_data->uri.c_str();
 	return uri[0] != '/' || !strrchr(uri, '/');
 }
 
 bool Song::isStream() const
 {
-	assert(m_song);
-	return !strncmp(mpd_song_get_uri(m_song.get()), "http://", 7);
+	assert(m_data);
+	return !strncmp(m_data->uri.c_str(), "http://", 7);
 }
 
 bool Song::empty() const
 {
-	return m_song.get() == 0;
+	return m_data.get() == 0;
 }
 
 std::string Song::ShowTime(unsigned length)
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 
+#include <boost/utility/string_ref.hpp>
 #include <mpd/client.h>
 
 namespace MPD {
@@ -37,23 +38,45 @@ struct Song
 		size_t operator()(const Song &s) const { return s.m_hash; }
 	};
 
+	struct Tag
+	{
+		mpd_tag_type type;
+		const std::string *value;
+	};
+	
 	typedef std::string (Song::*GetFunction)(unsigned) const;
+	typedef boost::string_ref (Song::*ViewFunction)(unsigned) const;
 	
 	Song() : m_hash(0) { }
 	virtual ~Song() { }
 	
 	Song(mpd_song *s);
+	
+	// Constructs song from the database out of already interned tags.
+	Song(std::string uri, std::vector<Tag> tags, unsigned duration, time_t mtime);
 
-	Song(const Song &rhs) : m_song(rhs.m_song), m_hash(rhs.m_hash) { }
-	Song(Song &&rhs) : m_song(std::move(rhs.m_song)), m_hash(rhs.m_hash) { }
+	Song(const Song &rhs) : m_data(rhs.m_data), m_hash(rhs.m_hash) { }
+	Song(Song &&rhs) : m_data(std::move(rhs.m_data)), m_hash(rhs.m_hash) { }
 	Song &operator=(Song rhs) {
-		m_song = std::move(rhs.m_song);
+		m_data = std::move(rhs.m_data);
 		m_hash = rhs.m_hash;
 		return *this;
 	}
 	
 	std::string get(mpd_tag_type type, unsigned idx = 0) const;
 	
+	// Tag values are interned, i.e. all songs share one copy of each distinct
+	// value, so the returned pointers can be compared and hashed instead of
+	// the strings themselves. Returns nullptr if the tag is not present.
+	const std::string *getInterned(mpd_tag_type type, unsigned idx = 0) const;
+	const std::vector<Tag> &getInternedTags() const { return m_data->tags; }
+	
+	// Values stay interned until the program exits, even when no song uses
+	// them anymore, so the pool only grows. It holds one copy of every
+	// distinct tag value seen, which for libraries that don't change much
+	// is close to the set of values in the library.
+	static const std::string *intern(boost::string_ref value);
+	
 	virtual std::string getURI(unsigned idx = 0) const;
 	virtual std::string getName(unsigned idx = 0) const;
 	virtual std::string getDirectory(unsigned idx = 0) const;
@@ -74,12 +97,44 @@ struct Song
 	
 	virtual std::string getTags(GetFunction f) const;
 	
+	// Non-virtual counterparts of the getters above. They don't allocate,
+	// returned views point either into the tag pool or into the uri of the
+	// song. Note that they see tags as received from MPD, so they ignore
+	// modifications made by MutableSong.
+	boost::string_ref viewTag(mpd_tag_type type, unsigned idx = 0) const;
+	
+	boost::string_ref viewURI(unsigned idx = 0) const;
+	boost::string_ref viewName(unsigned idx = 0) const;
+	boost::string_ref viewDirectory(unsigned idx = 0) const;
+	boost::string_ref viewArtist(unsigned idx = 0) const;
+	boost::string_ref viewTitle(unsigned idx = 0) const;
+	boost::string_ref viewAlbum(unsigned idx = 0) const;
+	boost::string_ref viewAlbumArtist(unsigned idx = 0) const;
+	boost::string_ref viewDate(unsigned idx = 0) const;
+	boost::string_ref viewGenre(unsigned idx = 0) const;
+	boost::string_ref viewComposer(unsigned idx = 0) const;
+	boost::string_ref viewPerformer(unsigned idx = 0) const;
+	boost::string_ref viewDisc(unsigned idx = 0) const;
+	boost::string_ref viewComment(unsigned idx = 0) const;
+	
+	// If there is only one value, returns view of it. Otherwise values
+	// are joined with TagsSeparator into buffer and view of it is returned.
+	boost::string_ref viewTags(ViewFunction f, std::string &buffer) const;
+	
+	// Returns view function that corresponds to given getter
+	// or nullptr if its value can't be viewed without allocation.
+	static ViewFunction toViewFunction(GetFunction f);
+	
 	virtual unsigned getDuration() const;
 	virtual unsigned getPosition() const;
 	virtual unsigned getID() const;
 	virtual unsigned getPrio() const;
 	virtual time_t getMTime() const;
 	
+	// Changes position of the song in the playlist. Copies of
+	// the song are not affected, tags are shared with them.
+	void setPosition(unsigned position);
+	
 	virtual bool isFromDatabase() const;
 	virtual bool isStream() const;
 	
@@ -96,14 +151,25 @@ struct Song
 		return strcmp(c_uri(), rhs.c_uri()) != 0;
 	}
 	
-	const char *c_uri() const { return m_song ? mpd_song_get_uri(m_song.get()) : ""; }
+	const char *c_uri() const { return m_data ? m_data->uri.c_str() : ""; }
 
 	static std::string ShowTime(unsigned length);
 
 	static std::string TagsSeparator;
 
 private:
-	std::shared_ptr<mpd_song> m_song;
+	struct Data
+	{
+		std::string uri;
+		std::vector<Tag> tags;
+		unsigned duration;
+		unsigned position;
+		unsigned id;
+		unsigned prio;
+		time_t mtime;
+	};
+	
+	std::shared_ptr<const Data> m_data;
 	size_t m_hash;
 };
 
@@ -18,6 +18,7 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <algorithm>
 #include <boost/bind.hpp>
 
 #include "charset.h"
@@ -29,10 +30,96 @@
 #include "sort_playlist.h"
 #include "statusbar.h"
 #include "utility/comparators.h"
+#include "utility/fenwick_tree.h"
 #include "screen_switcher.h"
 
 SortPlaylistDialog *mySortPlaylistDialog;
 
+namespace {
+
+// marks elements of the longest increasing subsequence of the sequence
+std::vector<bool> longestIncreasingSubsequence(const std::vector<size_t> &seq)
+{
+	// tails[i] is the index of the smallest element that ends an
+	// increasing subsequence of length i+1, prev links them backwards
+	std::vector<size_t> tails, prev(seq.size());
+	for (size_t i = 0; i < seq.size(); ++i)
+	{
+		auto it = std::lower_bound(tails.begin(), tails.end(), seq[i], [&seq](size_t j, size_t value) {
+			return seq[j] < value;
+		});
+		prev[i] = it == tails.begin() ? i : *(it-1);
+		if (it == tails.end())
+			tails.push_back(i);
+		else
+			*it = i;
+	}
+	std::vector<bool> result(seq.size());
+	if (!tails.empty())
+	{
+		size_t i = tails.back();
+		for (; prev[i] != i; i = prev[i])
+			result[i] = true;
+		result[i] = true;
+	}
+	return result;
+}
+
+// rearranges songs in playlist starting at offset so that the song at position
+// order[i] ends up at position i. songs forming the longest sequence that's
+// already in order stay in place, the rest is moved in runs of songs that are
+// adjacent both now and in the new order.
+void moveToOrder(const std::vector<size_t> &order, size_t offset)
+{
+	size_t n = order.size();
+	auto keep = longestIncreasingSubsequence(order);
+	
+	// songs that weren't moved yet, at their original positions, which also
+	// preserve their order. songs already in the new order are counted at
+	// the slot right after the kept song they follow (or at slot 0 if there
+	// is none), as all of them were put right after it.
+	FenwickTree<size_t> unmoved, placed;
+	for (size_t i = 0; i < n; ++i)
+	{
+		unmoved.push_back(0);
+		placed.push_back(0);
+	}
+	placed.push_back(0);
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (keep[i])
+			placed.set(order[i]+1, 1);
+		else
+			unmoved.set(order[i], 1);
+	}
+	
+	size_t anchor = 0;
+	for (size_t i = 0; i < n;)
+	{
+		if (keep[i])
+		{
+			anchor = order[i]+1;
+			++i;
+			continue;
+		}
+		size_t last = i+1;
+		while (last < n && !keep[last] && order[last] == order[last-1]+1)
+			++last;
+		size_t from = placed.sum(order[i]+1) + unmoved.sum(order[i]);
+		for (size_t j = i; j < last; ++j)
+		{
+			unmoved.set(order[j], 0);
+			placed.set(anchor, placed[anchor]+1);
+		}
+		size_t to = i + (anchor > 0 ? unmoved.sum(anchor-1) : 0);
+		if (from != to)
+			Mpd.MoveRange(offset+from, offset+from+(last-i), offset+to);
+		i = last;
+	}
+}
+
+}
+
 SortPlaylistDialog::SortPlaylistDialog()
 {
 	typedef WindowType::Item::Type Entry;
@@ -160,49 +247,38 @@ void SortPlaylistDialog::sort() const
 	std::tie(begin, end) = getSelectedRange(begin, end);
 	
 	size_t start_pos = begin - pl.begin();
-	std::vector<MPD::Song> playlist;
-	playlist.reserve(end - begin);
-	for (; begin != end; ++begin)
-		playlist.push_back(begin->value());
 	
-	typedef std::vector<MPD::Song>::iterator Iterator;
 	LocaleStringComparison cmp(std::locale(), Config.ignore_leading_the);
-	std::function<void(Iterator, Iterator)> iter_swap, quick_sort;
-	auto song_cmp = [this, &cmp](const MPD::Song &a, const MPD::Song &b) -> bool {
-		for (auto it = w.beginV();  it->item().second; ++it)
-		{
-			int res = cmp(a.getTags(it->item().second),
-			              b.getTags(it->item().second));
-			if (res != 0)
-				return res < 0;
-		}
-		return a.getPosition() < b.getPosition();
-	};
-	iter_swap = [&playlist, &start_pos](Iterator a, Iterator b) {
-		std::iter_swap(a, b);
-		Mpd.Swap(start_pos+a-playlist.begin(), start_pos+b-playlist.begin());
-	};
-	quick_sort = [this, &song_cmp, &quick_sort, &iter_swap](Iterator first, Iterator last) {
-		if (last-first > 1)
+	// tags that can be viewed are used without making copies of them
+	std::vector<std::pair<MPD::Song::GetFunction, MPD::Song::ViewFunction>> getters;
+	for (auto it = w.beginV(); it->item().second; ++it)
+		getters.push_back(std::make_pair(
+			it->item().second,
+			MPD::Song::toViewFunction(it->item().second)
+		));
+	
+	Statusbar::print("Sorting...");
+	// compute sort keys of songs once, so that each comparison
+	// is a plain comparison of bytes instead of going through locale
+	auto keys = sortedKeys(end-begin, [&begin, &cmp, &getters](size_t i) {
+		const MPD::Song &s = (begin+i)->value();
+		std::string key, buffer;
+		for (auto it = getters.begin(); it != getters.end(); ++it)
 		{
-			Iterator pivot = first+rand()%(last-first);
-			iter_swap(pivot, last-1);
-			pivot = last-1;
-			
-			Iterator tmp = first;
-			for (Iterator i = first; i != pivot; ++i)
-				if (song_cmp(*i, *pivot))
-					iter_swap(i, tmp++);
-			iter_swap(tmp, pivot);
-			
-			quick_sort(first, tmp);
-			quick_sort(tmp+1, last);
+			if (it->second)
+				cmp.appendKey(key, s.viewTags(it->second, buffer));
+			else
+				cmp.appendKey(key, s.getTags(it->first));
 		}
-	};
+		return key;
+	});
+	std::vector<size_t> order;
+	order.reserve(keys.size());
+	for (auto it = keys.begin(); it != keys.end(); ++it)
+		order.push_back(it->second);
 	
-	Statusbar::print("Sorting...");
 	Mpd.StartCommandsList();
-	quick_sort(playlist.begin(), playlist.end());
+	moveToOrder(order, start_pos);
 	Mpd.CommitCommandsList();
 	Statusbar::print("Playlist sorted");
 	switchToPreviousScreen();
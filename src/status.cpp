@@ -18,6 +18,8 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
@@ -26,6 +28,7 @@
 #include "charset.h"
 #include "global.h"
 #include "helpers.h"
+#include "library.h"
 #include "lyrics.h"
 #include "media_library.h"
 #include "outputs.h"
@@ -133,6 +136,65 @@ std::string playerStateToString(MPD::PlayerState ps)
 	return result;
 }
 
+// Checks whether songs in given directory or its subdirectories changed.
+bool changesDirectory(const Library::Changes &changes, const std::string &directory)
+{
+	if (directory == "/")
+		return !changes.removed.empty() || !changes.added.empty();
+	std::string prefix = directory + "/";
+	auto in_directory = [&prefix](const MPD::Song &s) {
+		return boost::starts_with(s.getURI(), prefix);
+	};
+	return std::any_of(changes.removed.begin(), changes.removed.end(), in_directory)
+	    || std::any_of(changes.added.begin(), changes.added.end(), in_directory);
+}
+
+// Gets songs that changed since given playlist version. Only positions and ids
+// of them are requested at first, songs that were moved within the playlist
+// are taken from it and only the rest is fetched. Returns false if the playlist
+// changed in the meantime and songs need to be fetched as a whole.
+bool getPlaylistChanges(unsigned version, std::vector<MPD::Song> &songs)
+{
+	auto changes = Mpd.GetPlaylistChangesPosId(version);
+	
+	const auto &pl = myPlaylist->main();
+	std::vector<size_t> missing;
+	songs.reserve(changes.size());
+	for (auto change = changes.begin(); change != changes.end(); ++change)
+	{
+		// entry that stayed at its position changed itself (e.g. its
+		// priority or tags of its song), so the known one is outdated
+		int known_pos = myPlaylist->songPosition(change->second);
+		if (known_pos >= 0 && size_t(known_pos) != change->first)
+		{
+			songs.push_back(pl[known_pos].value());
+			songs.back().setPosition(change->first);
+		}
+		else
+		{
+			missing.push_back(songs.size());
+			songs.push_back(MPD::Song());
+		}
+	}
+	
+	// fetch songs at consecutive positions with one request
+	for (size_t i = 0; i < missing.size();)
+	{
+		size_t j = i+1;
+		while (j < missing.size() && changes[missing[j]].first == changes[missing[j-1]].first+1)
+			++j;
+		unsigned start = changes[missing[i]].first;
+		MPD::SongIterator s = Mpd.GetPlaylistRange(start, start+(j-i)), end;
+		for (; i < j; ++i, ++s)
+		{
+			if (s == end || s->getID() != changes[missing[i]].second)
+				return false;
+			songs[missing[i]] = std::move(*s);
+		}
+	}
+	return true;
+}
+
 void initialize_status()
 {
 	// get full info about new connection
@@ -149,9 +211,9 @@ void initialize_status()
 		}
 	}
 
-	// Set TCP_NODELAY on the tcp socket as we are using write-write-read pattern
-	// a lot (noidle - write, command - write, then read the result of command),
-	// which kills the performance.
+	// Set TCP_NODELAY on the command socket so that short commands are sent
+	// out immediately. Idle events are received on a separate connection,
+	// so commands no longer need to be preceded by noidle.
 	int flag = 1;
 	setsockopt(Mpd.GetFD(), IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
 
@@ -166,7 +228,7 @@ void initialize_status()
 #	endif // ENABLE_VISUALIZER
 
 	m_status_initialized = true;
-	wFooter->addFDCallback(Mpd.GetFD(), Statusbar::Helpers::mpd);
+	wFooter->addFDCallback(Mpd.GetIdleFD(), Statusbar::Helpers::mpd);
 	Statusbar::printf("Connected to %1%", Mpd.GetHostname());
 }
 
@@ -230,6 +292,7 @@ void Status::trace(bool update_timer, bool update_window_timeout)
 		applyToVisibleWindows(&BaseScreen::update);
 		Statusbar::tryRedraw();
 
+		Mpd.keepAlive();
 		Mpd.idle();
 	}
 }
@@ -401,6 +464,18 @@ int Status::State::volume()
 
 void Status::Changes::playlist(unsigned previous_version)
 {
+	// this needs to be done before the playlist is truncated,
+	// as songs that were moved may be among the removed ones
+	std::vector<MPD::Song> songs;
+	if (!getPlaylistChanges(previous_version, songs))
+	{
+		songs.clear();
+		MPD::SongIterator s = Mpd.GetPlaylistChanges(previous_version), end;
+		for (; s != end; ++s)
+			songs.push_back(std::move(*s));
+	}
+	
+	myPlaylist->beginUpdate();
 	if (m_playlist_length < myPlaylist->main().size())
 	{
 		auto it = myPlaylist->main().begin()+m_playlist_length;
@@ -409,38 +484,42 @@ void Status::Changes::playlist(unsigned previous_version)
 			myPlaylist->unregisterSong(it->value());
 		myPlaylist->main().resizeList(m_playlist_length);
 	}
+	myPlaylist->truncateSongLengths(m_playlist_length);
 
-	MPD::SongIterator s = Mpd.GetPlaylistChanges(previous_version), end;
-	for (; s != end; ++s)
+	for (auto s = songs.begin(); s != songs.end(); ++s)
 	{
 		size_t pos = s->getPosition();
-		myPlaylist->registerSong(*s);
+		myPlaylist->setSongLength(pos, s->getDuration());
 		if (pos < myPlaylist->main().size())
 		{
-			// if song's already in playlist, replace it with a new one
+			// if song's already in playlist, replace it with a new one. old
+			// one needs to go first as it may be the same entry with updated
+			// tags or priority, which would remove the new one from the index
 			MPD::Song &old_s = myPlaylist->main()[pos].value();
 			myPlaylist->unregisterSong(old_s);
+			myPlaylist->registerSong(*s);
 			old_s = std::move(*s);
 		}
 		else // otherwise just add it to playlist
+		{
+			myPlaylist->registerSong(*s);
 			myPlaylist->main().addItem(std::move(*s));
+		}
 	}
-	
-	myPlaylist->reloadTotalLength();
-	myPlaylist->reloadRemaining();
+	myPlaylist->endUpdate();
 	
 	if (isVisible(myBrowser))
-		markSongsInPlaylist(myBrowser->proxySongList());
+		myBrowser->markSongsInPlaylist();
 	if (isVisible(mySearcher))
-		markSongsInPlaylist(mySearcher->proxySongList());
+		mySearcher->markSongsInPlaylist();
 	if (isVisible(myLibrary))
 	{
-		markSongsInPlaylist(myLibrary->songsProxyList());
+		myLibrary->markSongsInPlaylist();
 		myLibrary->Songs.refresh();
 	}
 	if (isVisible(myPlaylistEditor))
 	{
-		markSongsInPlaylist(myPlaylistEditor->contentProxyList());
+		myPlaylistEditor->markSongsInPlaylist();
 		myPlaylistEditor->Content.refresh();
 	}
 }
@@ -459,16 +538,20 @@ void Status::Changes::storedPlaylists()
 
 void Status::Changes::database()
 {
-	if (isVisible(myBrowser))
-		myBrowser->getDirectory(myBrowser->currentDirectory());
-	else
-		myBrowser->main().clear();
+	auto changes = Library::update();
+	// browser is reloaded only if songs in its directory (or its
+	// subdirectories, which could've been added or removed) changed
+	if (changes.reloaded || changesDirectory(changes, myBrowser->currentDirectory()))
+	{
+		if (isVisible(myBrowser))
+			myBrowser->getDirectory(myBrowser->currentDirectory());
+		else
+			myBrowser->main().clear();
+	}
 #	ifdef HAVE_TAGLIB_H
 	myTagEditor->Dirs->clear();
 #	endif // HAVE_TAGLIB_H
-	myLibrary->requestTagsUpdate();
-	myLibrary->requestAlbumsUpdate();
-	myLibrary->requestSongsUpdate();
+	myLibrary->libraryUpdated(changes);
 }
 
 void Status::Changes::playerState()
@@ -532,11 +615,9 @@ void Status::Changes::songID(int song_id)
 		auto &pl = myPlaylist->main();
 
 		// try to find the song with new id in the playlist
-		auto it = std::find_if(pl.beginV(), pl.endV(), [song_id](const MPD::Song &s) {
-			return s.getID() == unsigned(song_id);
-		});
+		int pos = myPlaylist->songPosition(song_id);
 		// if it's not there (playlist may be outdated), fetch it
-		const auto &s = it != pl.endV() ? *it : Mpd.GetCurrentSong();
+		const auto &s = pos >= 0 ? pl[pos].value() : Mpd.GetCurrentSong();
 
 		GNUC_UNUSED int res;
 		if (!Config.execute_on_song_change.empty())
@@ -246,7 +246,7 @@ void TagEditor::update()
 			if (directory->path() == itsHighlightedDir)
 				Dirs->highlight(Dirs->size()-1);
 		};
-		std::sort(Dirs->beginV()+1, Dirs->endV(),
+		sortByKeys(Dirs->beginV()+1, Dirs->endV(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		Dirs->display();
 	}
@@ -257,7 +257,7 @@ void TagEditor::update()
 		MPD::SongIterator s = Mpd.GetSongs(Dirs->current()->value().second), end;
 		for (; s != end; ++s)
 			Tags->addItem(std::move(*s));
-		std::sort(Tags->beginV(), Tags->endV(),
+		sortByKeys(Tags->beginV(), Tags->endV(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		Tags->refresh();
 	}
@@ -732,10 +732,15 @@ void TagEditor::setSearchConstraint(const std::string &constraint)
 	}
 	else if (w == Tags)
 	{
-		m_songs_search_predicate = RegexFilter<MPD::MutableSong>(
-			boost::regex(constraint, Config.regex_type),
-			SongEntryMatcher
-		);
+		if (Config.fuzzy_find)
+			m_songs_search_predicate = RegexFilter<MPD::MutableSong>(
+				FuzzyPattern(constraint), fuzzySongScore
+			);
+		else
+			m_songs_search_predicate = RegexFilter<MPD::MutableSong>(
+				boost::regex(constraint, Config.regex_type),
+				SongEntryMatcher
+			);
 	}
 }
 
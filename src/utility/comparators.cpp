@@ -18,15 +18,19 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include "config.h"
+
+#include <boost/thread/future.hpp>
+#include <boost/thread/thread.hpp>
 #include <locale>
 #include "comparators.h"
 #include "utility/string.h"
 
 namespace {
 
-bool hasTheWord(const std::string &s)
+bool hasTheWord(const char *s, size_t len)
 {
-	return s.length() >= 4
+	return len >= 4
 	&&     (s[0] == 't' || s[0] == 'T')
 	&&     (s[1] == 'h' || s[1] == 'H')
 	&&     (s[2] == 'e' || s[2] == 'E')
@@ -40,9 +44,9 @@ int LocaleStringComparison::compare(const char *a, size_t a_len, const char *b,
 	size_t ac_off = 0, bc_off = 0;
 	if (m_ignore_the)
 	{
-		if (hasTheWord(a))
+		if (hasTheWord(a, a_len))
 			ac_off += 4;
-		if (hasTheWord(b))
+		if (hasTheWord(b, b_len))
 			bc_off += 4;
 	}
 	return std::use_facet<std::collate<char>>(m_locale).compare(
@@ -50,61 +54,120 @@ int LocaleStringComparison::compare(const char *a, size_t a_len, const char *b,
 	);
 }
 
-bool LocaleBasedItemSorting::operator()(const MPD::Item &a, const MPD::Item &b) const
+void LocaleStringComparison::appendKey(std::string &key, const char *s, size_t len) const
+{
+	if (m_ignore_the && hasTheWord(s, len))
+	{
+		s += 4;
+		len -= 4;
+	}
+	key += std::use_facet<std::collate<char>>(m_locale).transform(s, s+len);
+	key += '\0';
+}
+
+void appendNumberKey(std::string &key, int64_t n)
+{
+	// flip the sign bit so that negative numbers go first
+	uint64_t u = static_cast<uint64_t>(n) ^ (uint64_t(1) << 63);
+	for (int shift = 56; shift >= 0; shift -= 8)
+		key += static_cast<char>((u >> shift) & 0xff);
+}
+
+SortKeys sortedKeys(size_t n, const std::function<std::string(size_t)> &key)
 {
-	bool result = false;
-	if (a.type() == b.type())
+	SortKeys keys(n);
+	size_t chunks = 1;
+	if (Config.parallel_sort_threshold > 0 && n > Config.parallel_sort_threshold)
+		chunks = std::max(boost::thread::hardware_concurrency(), 1u);
+	std::vector<size_t> bounds;
+	for (size_t i = 0; i <= chunks; ++i)
+		bounds.push_back(n*i/chunks);
+	
+	// every chunk computes and sorts its keys...
+	auto sort_chunk = [&keys, &bounds, &key](size_t i) {
+		for (size_t j = bounds[i]; j < bounds[i+1]; ++j)
+			keys[j] = SortKeys::value_type(key(j), j);
+		std::sort(keys.begin()+bounds[i], keys.begin()+bounds[i+1]);
+	};
+	std::vector<boost::future<void>> workers;
+	for (size_t i = 1; i < chunks; ++i)
+		workers.push_back(boost::async(boost::launch::async, [&sort_chunk, i] {
+			sort_chunk(i);
+		}));
+	sort_chunk(0);
+	for (auto &worker : workers)
+		worker.get();
+	
+	// ...and then neighbouring sorted chunks are merged in pairs.
+	for (size_t step = 1; step < chunks; step *= 2)
 	{
-		switch (m_sort_mode)
+		workers.clear();
+		for (size_t i = 0; i+step < chunks; i += 2*step)
 		{
-			case SortMode::Name:
-				switch (a.type())
-				{
-					case MPD::Item::Type::Directory:
-						result = m_cmp(a.directory().path(), b.directory().path());
-						break;
-					case MPD::Item::Type::Playlist:
-						result = m_cmp(a.playlist().path(), b.playlist().path());
-						break;
-					case MPD::Item::Type::Song:
-						result = m_cmp(a.song(), b.song());
-						break;
-				}
-				break;
-			case SortMode::CustomFormat:
-				switch (a.type())
-				{
-					case MPD::Item::Type::Directory:
-						result = m_cmp(a.directory().path(), b.directory().path());
-						break;
-					case MPD::Item::Type::Playlist:
-						result = m_cmp(a.playlist().path(), b.playlist().path());
-						break;
-					case MPD::Item::Type::Song:
-						result = m_cmp(Format::stringify<char>(Config.browser_sort_format, &a.song()),
-						               Format::stringify<char>(Config.browser_sort_format, &b.song()));
-						break;
-				}
-				break;
-			case SortMode::ModificationTime:
-				switch (a.type())
-				{
-					case MPD::Item::Type::Directory:
-						result = a.directory().lastModified() > b.directory().lastModified();
-						break;
-					case MPD::Item::Type::Playlist:
-						result = a.playlist().lastModified() > b.playlist().lastModified();
-						break;
-					case MPD::Item::Type::Song:
-						result = a.song().getMTime() > b.song().getMTime();
-						break;
-				}
-				break;
-			case SortMode::NoOp:
-				throw std::logic_error("can't sort with NoOp sorting mode");
+			auto first = keys.begin()+bounds[i];
+			auto middle = keys.begin()+bounds[i+step];
+			auto last = keys.begin()+bounds[std::min(i+2*step, chunks)];
+			workers.push_back(boost::async(boost::launch::async, [first, middle, last] {
+				std::inplace_merge(first, middle, last);
+			}));
 		}
+		for (auto &worker : workers)
+			worker.get();
+	}
+	return keys;
+}
+
+std::string LocaleBasedItemSorting::key(const MPD::Item &item) const
+{
+	// items of different types are never mixed
+	std::string result(1, static_cast<char>(item.type()));
+	switch (m_sort_mode)
+	{
+		case SortMode::Name:
+			switch (item.type())
+			{
+				case MPD::Item::Type::Directory:
+					result += m_cmp.key(item.directory().path());
+					break;
+				case MPD::Item::Type::Playlist:
+					result += m_cmp.key(item.playlist().path());
+					break;
+				case MPD::Item::Type::Song:
+					result += m_cmp.key(item.song());
+					break;
+			}
+			break;
+		case SortMode::CustomFormat:
+			switch (item.type())
+			{
+				case MPD::Item::Type::Directory:
+					result += m_cmp.key(item.directory().path());
+					break;
+				case MPD::Item::Type::Playlist:
+					result += m_cmp.key(item.playlist().path());
+					break;
+				case MPD::Item::Type::Song:
+					result += m_cmp.key(Format::stringify<char>(Config.browser_sort_format, &item.song()));
+					break;
+			}
+			break;
+		case SortMode::ModificationTime:
+			// newest first
+			switch (item.type())
+			{
+				case MPD::Item::Type::Directory:
+					appendNumberKey(result, -int64_t(item.directory().lastModified()));
+					break;
+				case MPD::Item::Type::Playlist:
+					appendNumberKey(result, -int64_t(item.playlist().lastModified()));
+					break;
+				case MPD::Item::Type::Song:
+					appendNumberKey(result, -int64_t(item.song().getMTime()));
+					break;
+			}
+			break;
+		case SortMode::NoOp:
+			throw std::logic_error("can't sort with NoOp sorting mode");
 	}
-	else
-		result = a.type() < b.type();
 	return result;
 }
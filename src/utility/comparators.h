@@ -21,7 +21,12 @@
 #ifndef NCMPCPP_UTILITY_COMPARATORS_H
 #define NCMPCPP_UTILITY_COMPARATORS_H
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
 #include "runnable_item.h"
 #include "mpdpp.h"
 #include "settings.h"
@@ -42,10 +47,62 @@ public:
 	int operator()(const std::string &a, const std::string &b) const {
 		return compare(a.c_str(), a.length(), b.c_str(), b.length());
 	}
+	int operator()(boost::string_ref a, boost::string_ref b) const {
+		return compare(a.data(), a.length(), b.data(), b.length());
+	}
 
 	int compare(const char *a, size_t a_len, const char *b, size_t b_len) const;
+	
+	/// Appends collation key of the string to the key. Keys compare as plain
+	/// bytes the same way compare() compares the strings. The key of every
+	/// string is terminated with zero byte, so keys of multiple strings can
+	/// be concatenated to compare by more than one field.
+	void appendKey(std::string &key, const char *s, size_t len) const;
+	void appendKey(std::string &key, boost::string_ref s) const {
+		appendKey(key, s.data(), s.length());
+	}
+	
+	std::string key(boost::string_ref s) const {
+		std::string result;
+		appendKey(result, s);
+		return result;
+	}
 };
 
+/// Appends fixed width key of the number to the key, which compares as
+/// plain bytes the same way as the number does.
+void appendNumberKey(std::string &key, int64_t n);
+
+typedef std::vector<std::pair<std::string, size_t>> SortKeys;
+
+/// Returns keys of n elements computed with the function, paired with indexes
+/// of the elements and sorted. Lists longer than parallel_sort_threshold are
+/// processed on all available cores.
+SortKeys sortedKeys(size_t n, const std::function<std::string(size_t)> &key);
+
+/// Sorts the range by keys computed once per element with sort.key().
+/// Elements with equal keys keep their relative order.
+template <typename IteratorT, typename SortT>
+void sortByKeys(IteratorT first, IteratorT last, const SortT &sort)
+{
+	auto keys = sortedKeys(last-first, [&first, &sort](size_t i) {
+		return sort.key(*(first+i));
+	});
+	// move elements to their places following cycles of the permutation
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		for (size_t j = i;;)
+		{
+			size_t k = keys[j].second;
+			keys[j].second = j;
+			if (k == i)
+				break;
+			std::iter_swap(first+j, first+k);
+			j = k;
+		}
+	}
+}
+
 class LocaleBasedSorting
 {
 	LocaleStringComparison m_cmp;
@@ -62,7 +119,7 @@ public:
 	}
 
 	bool operator()(const MPD::Song &a, const MPD::Song &b) const {
-		return m_cmp(a.getName(), b.getName()) < 0;
+		return m_cmp(a.viewName(), b.viewName()) < 0;
 	}
 	
 	template <typename A, typename B>
@@ -74,6 +131,28 @@ public:
 	bool operator()(const RunnableItem<ItemT, FunT> &a, const RunnableItem<ItemT, FunT> &b) const {
 		return m_cmp(a.item(), b.item()) < 0;
 	}
+	
+	std::string key(const std::string &s) const {
+		return m_cmp.key(s);
+	}
+	
+	std::string key(const MPD::Playlist &p) const {
+		return m_cmp.key(p.path());
+	}
+	
+	std::string key(const MPD::Song &s) const {
+		return m_cmp.key(s.viewName());
+	}
+	
+	template <typename A, typename B>
+	std::string key(const std::pair<A, B> &p) const {
+		return m_cmp.key(p.first);
+	}
+	
+	template <typename ItemT, typename FunT>
+	std::string key(const RunnableItem<ItemT, FunT> &item) const {
+		return m_cmp.key(item.item());
+	}
 };
 
 class LocaleBasedItemSorting
@@ -85,10 +164,10 @@ public:
 	LocaleBasedItemSorting(const std::locale &loc, bool ignore_the, SortMode mode)
 	: m_cmp(loc, ignore_the), m_sort_mode(mode) { }
 	
-	bool operator()(const MPD::Item &a, const MPD::Item &b) const;
+	std::string key(const MPD::Item &item) const;
 	
-	bool operator()(const NC::Menu<MPD::Item>::Item &a, const NC::Menu<MPD::Item>::Item &b) const {
-		return (*this)(a.value(), b.value());
+	std::string key(const NC::Menu<MPD::Item>::Item &item) const {
+		return key(item.value());
 	}
 };
 
@@ -0,0 +1,92 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef NCMPCPP_UTILITY_FENWICK_TREE_H
+#define NCMPCPP_UTILITY_FENWICK_TREE_H
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// sequence of numbers that keeps track of their prefix sums, so that both
+// changing a number and getting the sum of a prefix take O(log n) time
+template <typename ValueT>
+class FenwickTree
+{
+	// m_tree[i-1] holds the sum of values in range [i-lowbit(i), i)
+	std::vector<ValueT> m_values;
+	std::vector<ValueT> m_tree;
+	
+	static size_t lowbit(size_t i) { return i & (~i + 1); }
+	
+public:
+	size_t size() const { return m_values.size(); }
+	
+	const ValueT &operator[](size_t pos) const { return m_values[pos]; }
+	
+	void clear()
+	{
+		m_values.clear();
+		m_tree.clear();
+	}
+	
+	// shrinking the sequence doesn't change the sums of remaining prefixes
+	void truncate(size_t new_size)
+	{
+		if (new_size < size())
+		{
+			m_values.resize(new_size);
+			m_tree.resize(new_size);
+		}
+	}
+	
+	void push_back(ValueT value)
+	{
+		size_t i = size()+1;
+		m_values.push_back(value);
+		m_tree.push_back(value + sum(i-1) - sum(i-lowbit(i)));
+	}
+	
+	void set(size_t pos, ValueT value)
+	{
+		assert(pos < size());
+		ValueT old_value = m_values[pos];
+		m_values[pos] = value;
+		for (size_t i = pos+1; i <= size(); i += lowbit(i))
+		{
+			m_tree[i-1] -= old_value;
+			m_tree[i-1] += value;
+		}
+	}
+	
+	// returns the sum of values in range [0, end)
+	ValueT sum(size_t end) const
+	{
+		assert(end <= size());
+		ValueT result = ValueT();
+		for (; end > 0; end -= lowbit(end))
+			result += m_tree[end-1];
+		return result;
+	}
+	
+	ValueT total() const { return sum(size()); }
+};
+
+#endif // NCMPCPP_UTILITY_FENWICK_TREE_H
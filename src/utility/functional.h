@@ -22,6 +22,7 @@
 #define NCMPCPP_UTILITY_FUNCTIONAL_H
 
 #include <boost/locale/encoding_utf.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <utility>
 
 // identity function object
@@ -43,6 +44,10 @@ struct convertString
 	{
 		return boost::locale::conv::utf_to_utf<TargetT>(s);
 	}
+	static std::basic_string<TargetT> apply(const boost::basic_string_ref<SourceT> &s)
+	{
+		return boost::locale::conv::utf_to_utf<TargetT>(s.begin(), s.end());
+	}
 };
 template <typename TargetT>
 struct convertString<TargetT, TargetT>
@@ -51,6 +56,10 @@ struct convertString<TargetT, TargetT>
 	{
 		return s;
 	}
+	static std::basic_string<TargetT> apply(const boost::basic_string_ref<TargetT> &s)
+	{
+		return s.to_string();
+	}
 };
 
 
@@ -0,0 +1,195 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#include <cctype>
+#include "utility/fuzzy_match.h"
+
+namespace {
+
+const unsigned MaxErrors = 2;
+
+// score of a substring match is lowered by each typo
+const int SubstringScore = 1000;
+const int ErrorPenalty = 300;
+const int SubsequenceScore = 300;
+const int WordStartBonus = 100;
+const int WholeStringBonus = 100;
+const int GapPenalty = 15;
+
+char foldCase(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+bool isWordStart(boost::string_ref s, size_t pos)
+{
+	return pos == 0 || !isalnum(static_cast<unsigned char>(s[pos-1]));
+}
+
+// allow more typos in longer words, so that
+// short ones don't match almost everything.
+unsigned allowedErrors(size_t length)
+{
+	if (length <= 3)
+		return 0;
+	else if (length <= 6)
+		return 1;
+	else
+		return MaxErrors;
+}
+
+}
+
+FuzzyPattern::FuzzyPattern(const std::string &pattern)
+{
+	size_t start = 0;
+	while (start < pattern.size())
+	{
+		size_t end = pattern.find(' ', start);
+		if (end == std::string::npos)
+			end = pattern.size();
+		if (end > start)
+			m_words.emplace_back(boost::string_ref(pattern).substr(start, end-start));
+		start = end+1;
+	}
+}
+
+int FuzzyPattern::score(const boost::string_ref *first, const boost::string_ref *last) const
+{
+	int result = 0;
+	for (const auto &word : m_words)
+	{
+		int best = -1;
+		for (auto s = first; s != last; ++s)
+			best = std::max(best, word.score(*s));
+		if (best < 0)
+			return -1;
+		result += best;
+	}
+	return result;
+}
+
+FuzzyPattern::Word::Word(boost::string_ref word)
+{
+	m_word.reserve(word.size());
+	std::transform(word.begin(), word.end(), std::back_inserter(m_word), foldCase);
+	m_errors = allowedErrors(m_word.size());
+	m_masks.fill(0);
+	for (size_t i = 0; i < m_word.size() && i < 64; ++i)
+	{
+		uint64_t bit = uint64_t(1) << i;
+		unsigned char c = m_word[i];
+		m_masks[c] |= bit;
+		if (c >= 'a' && c <= 'z')
+			m_masks[c - 'a' + 'A'] |= bit;
+	}
+}
+
+int FuzzyPattern::Word::score(boost::string_ref s) const
+{
+	int result = substringScore(s);
+	if (result < 0)
+		result = subsequenceScore(s);
+	return result;
+}
+
+// Finds the word in the string with at most m_errors insertions, deletions
+// or substitutions (Wu-Manber variant of the bitap algorithm). Bit i of
+// state[d] is set if the first i+1 characters of the word match the string
+// ending at the current position with at most d errors.
+int FuzzyPattern::Word::substringScore(boost::string_ref s) const
+{
+	const size_t length = m_word.size();
+	if (length > 64)
+	{
+		auto it = std::search(s.begin(), s.end(), m_word.begin(), m_word.end(),
+			[](char a, char b) { return foldCase(a) == b; }
+		);
+		return it != s.end() ? SubstringScore : -1;
+	}
+	
+	const uint64_t found = uint64_t(1) << (length-1);
+	uint64_t state[MaxErrors+1];
+	for (unsigned d = 0; d <= m_errors; ++d)
+		state[d] = (uint64_t(1) << d) - 1;
+	
+	int errors = -1;
+	bool at_word_start = false;
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		uint64_t mask = m_masks[static_cast<unsigned char>(s[i])];
+		uint64_t previous = state[0];
+		state[0] = ((state[0] << 1) | 1) & mask;
+		for (unsigned d = 1; d <= m_errors; ++d)
+		{
+			uint64_t old = state[d];
+			state[d] = (((old << 1) | 1) & mask) // match
+			         | (previous << 1) | 1       // substitution
+			         | (state[d-1] << 1)         // deletion
+			         | previous;                 // insertion
+			previous = old;
+		}
+		// states with more errors allowed are supersets of the ones
+		// with fewer, so the last one tells whether there is a match.
+		if (state[m_errors] & found)
+		{
+			unsigned d = 0;
+			while (!(state[d] & found))
+				++d;
+			if (errors < 0 || unsigned(errors) > d)
+				errors = d;
+			if (d == 0 && isWordStart(s, i+1-length))
+				at_word_start = true;
+		}
+	}
+	
+	if (errors < 0)
+		return -1;
+	int result = SubstringScore - errors*ErrorPenalty;
+	if (at_word_start)
+		result += WordStartBonus;
+	if (errors == 0 && s.size() == length)
+		result += WholeStringBonus;
+	return result;
+}
+
+// Matches characters of the word one after another, so that
+// abbreviations and initials (e.g. "dsotm") are also found.
+int FuzzyPattern::Word::subsequenceScore(boost::string_ref s) const
+{
+	int result = SubsequenceScore;
+	size_t pos = 0;
+	bool in_run = false;
+	for (char c : m_word)
+	{
+		for (; pos < s.size() && foldCase(s[pos]) != c; ++pos)
+			in_run = false;
+		if (pos == s.size())
+			return -1;
+		if (isWordStart(s, pos))
+			result += WordStartBonus / 10;
+		else if (!in_run)
+			result -= GapPenalty;
+		in_run = true;
+		++pos;
+	}
+	return std::max(result, 1);
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#ifndef NCMPCPP_UTILITY_FUZZY_MATCH_H
+#define NCMPCPP_UTILITY_FUZZY_MATCH_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+// Approximate matching of strings. Pattern consists of words separated by
+// spaces, each of them has to be found in one of the matched strings either
+// as a substring with a few typos or as a subsequence. Case of ASCII letters
+// is ignored. The better the strings match, the higher their score is.
+struct FuzzyPattern
+{
+	FuzzyPattern() { }
+	explicit FuzzyPattern(const std::string &pattern);
+	
+	bool empty() const { return m_words.empty(); }
+	
+	// returns score of the best matching strings or -1 if they don't match
+	int score(const boost::string_ref *first, const boost::string_ref *last) const;
+	int score(boost::string_ref s) const { return score(&s, &s+1); }
+	
+private:
+	struct Word
+	{
+		Word(boost::string_ref word);
+		
+		int score(boost::string_ref s) const;
+		
+	private:
+		int substringScore(boost::string_ref s) const;
+		int subsequenceScore(boost::string_ref s) const;
+		
+		std::string m_word;
+		unsigned m_errors;
+		// for each character bits of positions it occupies in the word
+		std::array<uint64_t, 256> m_masks;
+	};
+	
+	std::vector<Word> m_words;
+};
+
+// Selects at most limit elements with the highest non-negative score, keeping
+// a heap of the best ones found so far, so that it takes O(n log limit) time.
+// Results are sorted from the best one, equally good ones in order of the range.
+template <typename IteratorT, typename ScoreT>
+std::vector<std::pair<int, IteratorT>> bestMatches(IteratorT first, IteratorT last,
+                                                   size_t limit, ScoreT score)
+{
+	typedef std::pair<int, IteratorT> Match;
+	auto better = [](const Match &a, const Match &b) {
+		return a.first > b.first || (a.first == b.first && a.second < b.second);
+	};
+	// the worst of kept matches is on the top of the heap
+	std::vector<Match> heap;
+	if (limit == 0)
+		return heap;
+	for (; first != last; ++first)
+	{
+		int s = score(*first);
+		if (s < 0)
+			continue;
+		if (heap.size() < limit)
+		{
+			heap.emplace_back(s, first);
+			std::push_heap(heap.begin(), heap.end(), better);
+		}
+		else if (s > heap.front().first)
+		{
+			std::pop_heap(heap.begin(), heap.end(), better);
+			heap.back() = Match(s, first);
+			std::push_heap(heap.begin(), heap.end(), better);
+		}
+	}
+	std::sort_heap(heap.begin(), heap.end(), better);
+	return heap;
+}
+
+#endif // NCMPCPP_UTILITY_FUZZY_MATCH_H
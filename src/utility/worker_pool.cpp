@@ -0,0 +1,102 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#include <algorithm>
+#include <exception>
+#include "utility/worker_pool.h"
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_task_added.notify_all();
+	for (auto &thread : m_threads)
+		thread.join();
+}
+
+size_t WorkerPool::concurrency() const
+{
+	return std::max(boost::thread::hardware_concurrency(), 1u);
+}
+
+void WorkerPool::run(size_t n, const std::function<void(size_t)> &f)
+{
+	std::vector<std::exception_ptr> errors(n);
+	size_t pending = n;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	// calling thread is one of the workers
+	while (m_threads.size()+1 < concurrency())
+		m_threads.push_back(boost::thread(&WorkerPool::work, this));
+	for (size_t i = 0; i < n; ++i)
+	{
+		m_tasks.push_back([this, &f, &errors, &pending, i] {
+			try
+			{
+				f(i);
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+			std::lock_guard<std::mutex> task_lock(m_mutex);
+			if (--pending == 0)
+				m_task_done.notify_all();
+		});
+	}
+	m_task_added.notify_all();
+	while (pending > 0)
+	{
+		if (!m_tasks.empty())
+		{
+			auto task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+		else
+			m_task_done.wait(lock);
+	}
+	lock.unlock();
+	for (auto &error : errors)
+		if (error)
+			std::rethrow_exception(error);
+}
+
+void WorkerPool::work()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_task_added.wait(lock, [this] {
+			return m_stop || !m_tasks.empty();
+		});
+		if (m_stop)
+			return;
+		auto task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
@@ -0,0 +1,59 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2014 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#ifndef NCMPCPP_UTILITY_WORKER_POOL_H
+#define NCMPCPP_UTILITY_WORKER_POOL_H
+
+#include "config.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <boost/thread/thread.hpp>
+
+// Threads that run parts of a computation in parallel. They're started when
+// they're needed for the first time and live as long as the pool does.
+struct WorkerPool
+{
+	WorkerPool() : m_stop(false) { }
+	~WorkerPool();
+	
+	// number of parts that can be run at the same time
+	size_t concurrency() const;
+	
+	// Calls f(0), ..., f(n-1) and waits until all of them return. Calling
+	// thread runs them as well. The first exception thrown is rethrown.
+	void run(size_t n, const std::function<void(size_t)> &f);
+	
+private:
+	void work();
+	
+	std::mutex m_mutex;
+	std::condition_variable m_task_added;
+	std::condition_variable m_task_done;
+	std::deque<std::function<void()>> m_tasks;
+	std::vector<boost::thread> m_threads;
+	bool m_stop;
+};
+
+#endif // NCMPCPP_UTILITY_WORKER_POOL_H